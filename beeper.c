@@ -0,0 +1,103 @@
+#include "beeper.h"
+
+int beeper_init(Beeper *bp, int sample_rate, double frequency, int16_t amplitude) {
+    bp->pos = 0;
+    bp->frac = 0.0;
+    bp->rate = 1.0;
+    bp->fill_avg = -1.0;
+    bp->phase = 0.0;
+    bp->step = frequency / sample_rate;
+    bp->amplitude = amplitude;
+    bp->on = 0;
+    atomic_init(&bp->fill, 0);
+    atomic_init(&bp->skew_ppm, 0);
+    atomic_init(&bp->resyncs, 0);
+    return spsc_init(&bp->edges, BEEPER_EDGE_QUEUE, sizeof(BeeperEdge));
+}
+
+void beeper_free(Beeper *bp) {
+    spsc_free(&bp->edges);
+}
+
+// Вызывается из потока эмуляции. Фронты должны идти по возрастанию времени.
+int beeper_push(Beeper *bp, int64_t time, int on) {
+    BeeperEdge edge = { time, (uint8_t)(on != 0) };
+    return spsc_push(&bp->edges, &edge);
+}
+
+// Поправка PolyBLEP: сглаживает скачок меандра на протяжении одного сэмпла
+static double polyblep(double t, double dt) {
+    if (t < dt) {
+        t /= dt;
+        return t + t - t * t - 1.0;
+    }
+    if (t > 1.0 - dt) {
+        t = (t - 1.0) / dt;
+        return t * t + t + t + 1.0;
+    }
+    return 0.0;
+}
+
+// Подстройка скорости воспроизведения. emu_time — докуда эмуляция уже
+// дошла, target — желаемый запас в сэмплах. Часы звуковой карты и эмуляции
+// расходятся; вместо того чтобы копить задержку или щёлкать, чуть ускоряем
+// или замедляем шкалу событий (не более чем на ±0.5%). Вызывать перед
+// каждым beeper_render().
+void beeper_sync(Beeper *bp, int64_t emu_time, int target) {
+    double fill = (double)(emu_time - bp->pos);
+
+    // Сильный разрыв (пауза, отставание эмуляции) — перескакиваем сразу
+    if (fill < 0 || fill > 4.0 * target) {
+        bp->pos = emu_time - target;
+        bp->frac = 0.0;
+        bp->fill_avg = target;
+        atomic_fetch_add(&bp->resyncs, 1);
+        fill = target;
+    }
+
+    // Запас растёт рывками по кадру, поэтому сглаживаем
+    if (bp->fill_avg < 0) bp->fill_avg = fill;
+    bp->fill_avg += 0.05 * (fill - bp->fill_avg);
+
+    double skew = (bp->fill_avg - target) / target * BEEPER_MAX_SKEW;
+    if (skew > BEEPER_MAX_SKEW) skew = BEEPER_MAX_SKEW;
+    if (skew < -BEEPER_MAX_SKEW) skew = -BEEPER_MAX_SKEW;
+    bp->rate = 1.0 + skew;
+
+    atomic_store_explicit(&bp->fill, (int)fill, memory_order_relaxed);
+    atomic_store_explicit(&bp->skew_ppm, (int)(skew * 1e6), memory_order_relaxed);
+}
+
+// Синтезирует samples сэмплов начиная с bp->pos. Фронт применяется
+// точно к своему сэмплу, а не на границе буфера.
+void beeper_render(Beeper *bp, int16_t *out, int samples) {
+    for (int i = 0; i < samples; i++) {
+        BeeperEdge *edge;
+        while ((edge = spsc_peek(&bp->edges)) && edge->time <= bp->pos) {
+            if (edge->on && !bp->on) bp->phase = 0.0; // Новая нота — с начала периода
+            bp->on = edge->on;
+            spsc_pop(&bp->edges);
+        }
+
+        // Шкала событий идёт со скоростью rate, высота тона не меняется
+        bp->frac += bp->rate;
+        int64_t whole = (int64_t)bp->frac;
+        bp->pos += whole;
+        bp->frac -= whole;
+
+        if (!bp->on) {
+            out[i] = 0;
+            continue;
+        }
+        double t = bp->phase;
+        double v = (t < 0.5) ? 1.0 : -1.0;
+        v += polyblep(t, bp->step);
+        double t2 = t + 0.5;
+        if (t2 >= 1.0) t2 -= 1.0;
+        v -= polyblep(t2, bp->step);
+        out[i] = (int16_t)(v * bp->amplitude);
+
+        bp->phase += bp->step;
+        if (bp->phase >= 1.0) bp->phase -= 1.0;
+    }
+}
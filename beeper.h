@@ -0,0 +1,49 @@
+#ifndef BEEPER_H
+#define BEEPER_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "spsc.h"
+#include "chip8.h"
+
+#define SAMPLE_RATE 44100
+#define TONE_FREQUENCY 440.0
+#define AMPLITUDE 3000
+#define SAMPLES_PER_FRAME (SAMPLE_RATE / FRAME_RATE)
+
+#define BEEPER_EDGE_QUEUE 1024
+#define BEEPER_MAX_SKEW 0.005     // Подстройка скорости не больше ±0.5%
+
+// Фронт сигнала бипера: время в сэмплах на шкале эмуляции
+typedef struct BeeperEdge {
+    int64_t time;
+    uint8_t on;
+} BeeperEdge;
+
+// Синтезатор бипера. Поток эмуляции кладёт фронты в очередь,
+// поток звука по ним синтезирует ограниченный по полосе меандр (PolyBLEP).
+// Модуль не зависит от SDL и годится и для офлайн-синтеза.
+typedef struct Beeper {
+    SpscRing edges;
+    int64_t pos;        // Время следующего сэмпла на шкале эмуляции
+    double frac;        // Дробная часть pos
+    double rate;        // Сэмплов эмуляции на один выходной сэмпл (~1.0)
+    double fill_avg;    // Сглаженный запас эмуляции перед воспроизведением
+    double phase;       // Фаза генератора, 0..1
+    double step;        // Приращение фазы за сэмпл
+    int16_t amplitude;
+    uint8_t on;         // Текущее состояние бипера
+
+    // Метрики для мониторинга (пишет поток звука, читать можно откуда угодно)
+    atomic_int fill;         // Текущий запас в сэмплах
+    atomic_int skew_ppm;     // Текущая подстройка скорости, миллионные доли
+    atomic_uint resyncs;     // Сколько раз пришлось перескочить на шкале
+} Beeper;
+
+int beeper_init(Beeper *bp, int sample_rate, double frequency, int16_t amplitude);
+void beeper_free(Beeper *bp);
+int beeper_push(Beeper *bp, int64_t time, int on);
+void beeper_sync(Beeper *bp, int64_t emu_time, int target);
+void beeper_render(Beeper *bp, int16_t *out, int samples);
+
+#endif
@@ -1,40 +1,23 @@
 #include "chip8.h"
 #include "fontset.h"
+#include "hash.h"
+#include "stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
 
-#define SCREEN_WIDTH 64
-#define SCREEN_HEIGHT 32
-#define MEMORY_SIZE 4096
-#define STACK_SIZE 16
-#define REGISTERS_COUNT 16
-#define KEY_COUNT 16
-
-typedef struct CHIP8 {
-    uint64_t display[SCREEN_WORDS]; // Экран (32x64) 2048
-    uint16_t stack[STACK_SIZE];    // Стек 32
-    uint16_t PC;                   // Счётчик команд 2
-    uint16_t I;                    // Регистр адреса 2
-    uint8_t memory[MEMORY_SIZE];   // Память 4096 
-    uint8_t V[REGISTERS_COUNT];    // Регистры V0-VF 16
-    uint8_t SP;                    // Указатель стека 1
-    uint8_t DT;                    // Таймер задержки 1
-    volatile uint8_t ST;                    // Звуковой таймер 1
-    uint8_t keys[KEY_COUNT];       // Состояние клавиш 16
-    uint8_t draw_flag;             // Флаг обновления экрана 1
-} CHIP8;
-
  void initialize(CHIP8 *chip) {
     memset(chip, 0, sizeof(CHIP8));
     
     // Загрузка шрифтов в память
     memcpy(&chip->memory[0x50], fontset, sizeof(fontset));
     
-    chip->PC = 0x200; // Стартовый адрес программ
-    chip->draw_flag = 1;
+    chip->PC = ROM_START; // Стартовый адрес программ
+    chip->cycles_per_tick = INSTRUCTIONS_PER_FRAME;
+    chip->rng = DEFAULT_SEED;
+    chip->dirty_rows = ALL_ROWS;
 }
 
  int load_rom(CHIP8 *chip, const char *filename) {
@@ -50,31 +33,84 @@ typedef struct CHIP8 {
     rewind(file);   // возврашает в начало
     
     // Проверяем, помещается ли ROM в память
-    if (size > MEMORY_SIZE - 0x200) {
+    if (size > MEMORY_SIZE - ROM_START) {
         printf("Error: ROM too large\n");
         fclose(file);
         return 0;
     }
     
     // Читаем ROM в память начиная с 0x200
-    if (fread(&chip->memory[0x200], 1, size, file) != size) {
+    if (fread(&chip->memory[ROM_START], 1, size, file) != size) {
         printf("Error: Reading ROM failed\n");
         fclose(file);
         return 0;
     }
     
     fclose(file);
+    rom_loaded(chip, (int)size);
     printf("Loaded ROM: %s (%ld bytes)\n", filename, size);
     return 1;
 }
 
+// Вызывается после записи ROM в память любым способом (файл, база):
+// хэш содержимого — ключ для поиска настроек игры
+void rom_loaded(CHIP8 *chip, int size) {
+    chip->rom_hash = xxh64(&chip->memory[ROM_START], (size_t)size, 0);
+}
+
  uint16_t fetch_opcode(CHIP8 *chip) {
-    return (chip->memory[chip->PC] << 8) | chip->memory[chip->PC + 1];
+    uint16_t pc = chip->PC & ADDR_MASK; // PC + 1 при PC = 0xFFF попадает в зеркало
+    return (chip->memory[pc] << 8) | chip->memory[pc + 1];
+}
+
+// Согласует зеркало после записи len байт (len <= MEMORY_GUARD) начиная с addr:
+// байты, попавшие за конец памяти, переносятся в её начало, а запись в
+// начало памяти копируется в зеркало. Одна проверка на инструкцию.
+static void memory_wrap_writes(CHIP8 *chip, uint16_t addr, int len) {
+    if (addr + len > MEMORY_SIZE) {
+        memcpy(chip->memory, &chip->memory[MEMORY_SIZE], addr + len - MEMORY_SIZE);
+    } else if (addr < MEMORY_GUARD) {
+        memcpy(&chip->memory[MEMORY_SIZE], chip->memory, MEMORY_GUARD);
+    }
 }
 
 void clear_screen(CHIP8 *chip) {
     memset(chip->display, 0, sizeof(chip->display));
-    chip->draw_flag = 1;
+    chip->dirty_rows = ALL_ROWS;
+}
+
+// Приблизительная длительность инструкций интерпретатора COSMAC VIP в
+// машинных циклах (по замерам на реальном VIP, включая выборку и
+// декодирование). Dxyn считается отдельно: ожидание кадра плюс отрисовка.
+static uint32_t vip_cycles(uint16_t opcode) {
+    uint8_t x = (opcode >> 8) & 0x0F;
+
+    switch (opcode & 0xF000) {
+        case 0x0000: return opcode == 0x00E0 ? 24 : 23;
+        case 0x1000: return 23;
+        case 0x2000: return 23;
+        case 0x3000: return 12;
+        case 0x4000: return 12;
+        case 0x5000: return 16;
+        case 0x6000: return 6;
+        case 0x7000: return 10;
+        case 0x8000: return 44;
+        case 0x9000: return 16;
+        case 0xA000: return 12;
+        case 0xB000: return 23;
+        case 0xC000: return 36;
+        case 0xE000: return 16;
+        case 0xF000:
+            switch (opcode & 0xFF) {
+                case 0x1E: return 19;
+                case 0x29: return 20;
+                case 0x33: return 204;
+                case 0x55:
+                case 0x65: return 18 + 14 * (x + 1);
+                default:   return 10;
+            }
+        default: return 10;
+    }
 }
 
  void execute(CHIP8 *chip, uint16_t opcode) {
@@ -84,6 +120,7 @@ void clear_screen(CHIP8 *chip) {
     uint8_t kk = opcode & 0xFF;
     uint16_t nnn = opcode & 0x0FFF;
 
+    STATS_OPCODE(chip->PC, opcode);
     switch (opcode & 0xF000) {
         case 0x0000:
             switch (opcode) {
@@ -166,9 +203,12 @@ void clear_screen(CHIP8 *chip) {
                     chip->PC += 2;
                     break;
                 case 0x6: // Vx = Vx SHR 1
-                    chip->V[0xF] = chip->V[x] & 0x1;
-                    chip->V[x] >>= 1;
-                    chip->PC += 2;
+                    {
+                        uint8_t src = (chip->quirks & QUIRK_SHIFT_VY) ? chip->V[y] : chip->V[x];
+                        chip->V[0xF] = src & 0x1;
+                        chip->V[x] = src >> 1;
+                        chip->PC += 2;
+                    }
                     break;
                 case 0x7: // Vx = Vy - Vx
                     chip->V[0xF] = (chip->V[y] > chip->V[x]) ? 1 : 0;
@@ -176,9 +216,12 @@ void clear_screen(CHIP8 *chip) {
                     chip->PC += 2;
                     break;
                 case 0xE: // Vx = Vx SHL 1
-                    chip->V[0xF] = (chip->V[x] & 0x80) >> 7;
-                    chip->V[x] <<= 1;
-                    chip->PC += 2;
+                    {
+                        uint8_t src = (chip->quirks & QUIRK_SHIFT_VY) ? chip->V[y] : chip->V[x];
+                        chip->V[0xF] = (src & 0x80) >> 7;
+                        chip->V[x] = src << 1;
+                        chip->PC += 2;
+                    }
                     break;
                 default:
                     chip->PC += 2;
@@ -196,24 +239,42 @@ void clear_screen(CHIP8 *chip) {
             break;
 
         case 0xB000: // Прыжок на nnn + V0
-            chip->PC = nnn + chip->V[0];
+            chip->PC = nnn + chip->V[(chip->quirks & QUIRK_JUMP_VX) ? x : 0];
             break;
 
         case 0xC000: // Vx = случайное число AND kk
-            chip->V[x] = (rand() % 256) & kk;
+            {
+                // xorshift32: своё состояние у каждого экземпляра, без общего rand()
+                uint32_t r = chip->rng;
+                r ^= r << 13;
+                r ^= r >> 17;
+                r ^= r << 5;
+                chip->rng = r;
+                chip->V[x] = (uint8_t)(r >> 24) & kk;
+            }
             chip->PC += 2;
             break;
 
         case 0xD000: // Отображение спрайта
             {
+                STATS_DRAW_BEGIN();
                 uint8_t vx = chip->V[x];
                 uint8_t vy = chip->V[y];
                 uint8_t height = n;
+                const uint8_t *src = &chip->memory[chip->I & ADDR_MASK];
                 
                 chip->V[0xF] = 0;
+
+                // VIP рисует только после прерывания дисплея: остаток кадра
+                // уходит на ожидание, стоимость отрисовки ложится на следующий
+                if (chip->vip_timing) {
+                    uint64_t t = chip->cycles + chip->cycles_per_tick - 1;
+                    chip->cycles = t - t % chip->cycles_per_tick;
+                    chip->cycles += 15 + height * (10 + 4 * (vx & 7));
+                }
                 
                 for (int row = 0; row < height; row++) {
-                    uint8_t sprite = chip->memory[chip->I + row];
+                    uint8_t sprite = src[row];
                     int pixel_y = (vy + row) % SCREEN_HEIGHT;
                     uint64_t *row_b = &chip->display[pixel_y];
                     
@@ -227,7 +288,13 @@ void clear_screen(CHIP8 *chip) {
                     }
                 }
                 
-                chip->draw_flag = 1;
+                // Помечаем затронутые строки (с переносом через нижний край)
+                if (height) {
+                    uint32_t rows = (1u << height) - 1; // height <= 15
+                    int shift = vy % SCREEN_HEIGHT;
+                    chip->dirty_rows |= (rows << shift) | (shift ? rows >> (SCREEN_HEIGHT - shift) : 0);
+                }
+                STATS_DRAW_END();
                 chip->PC += 2;
             }
             break;
@@ -249,7 +316,17 @@ void clear_screen(CHIP8 *chip) {
         case 0xF000:
             switch (kk) {
                 case 0x07: // Vx = DT
-                    chip->V[x] = chip->DT;
+                    chip->V[x] = delay_timer(chip);
+                    // Повторный опрос с того же адреса, пока DT идёт, — цикл
+                    // ожидания; время между опросами считаем простоем
+                    if (chip->V[x]) {
+                        if (chip->dt_poll_pc == chip->PC && chip->dt_poll_at)
+                            chip->dt_wait += chip->cycles - chip->dt_poll_at;
+                        chip->dt_poll_pc = chip->PC;
+                        chip->dt_poll_at = chip->cycles;
+                    } else {
+                        chip->dt_poll_at = 0;
+                    }
                     chip->PC += 2;
                     break;
                 case 0x0A: // Ожидание нажатия клавиши
@@ -271,10 +348,12 @@ void clear_screen(CHIP8 *chip) {
                     break;
                 case 0x15: // DT = Vx
                     chip->DT = chip->V[x];
+                    chip->DT_set = chip->cycles;
                     chip->PC += 2;
                     break;
                 case 0x18: // ST = Vx
                     chip->ST = chip->V[x];
+                    chip->ST_set = chip->cycles;
                     chip->PC += 2;
                     break;
                 case 0x1E: // I += Vx
@@ -286,21 +365,34 @@ void clear_screen(CHIP8 *chip) {
                     chip->PC += 2;
                     break;
                 case 0x33: // Сохранение BCD представления Vx в памяти
-                    chip->memory[chip->I] = chip->V[x] / 100;
-                    chip->memory[chip->I + 1] = (chip->V[x] / 10) % 10;
-                    chip->memory[chip->I + 2] = chip->V[x] % 10;
-                    chip->PC += 2;
+                    {
+                        uint16_t addr = chip->I & ADDR_MASK;
+                        chip->memory[addr] = chip->V[x] / 100;
+                        chip->memory[addr + 1] = (chip->V[x] / 10) % 10;
+                        chip->memory[addr + 2] = chip->V[x] % 10;
+                        memory_wrap_writes(chip, addr, 3);
+                        chip->PC += 2;
+                    }
                     break;
                 case 0x55: // Сохранение регистров V0-Vx в памяти
-                    for (int i = 0; i <= x; i++) {
-                        chip->memory[chip->I + i] = chip->V[i];
+                    {
+                        uint16_t addr = chip->I & ADDR_MASK;
+                        for (int i = 0; i <= x; i++) {
+                            chip->memory[addr + i] = chip->V[i];
+                        }
+                        memory_wrap_writes(chip, addr, x + 1);
                     }
+                    if (chip->quirks & QUIRK_LOAD_STORE) chip->I += x + 1;
                     chip->PC += 2;
                     break;
                 case 0x65: // Загрузка регистров V0-Vx из памяти
-                    for (int i = 0; i <= x; i++) {
-                        chip->V[i] = chip->memory[chip->I + i];
+                    {
+                        const uint8_t *src = &chip->memory[chip->I & ADDR_MASK];
+                        for (int i = 0; i <= x; i++) {
+                            chip->V[i] = src[i];
+                        }
                     }
+                    if (chip->quirks & QUIRK_LOAD_STORE) chip->I += x + 1;
                     chip->PC += 2;
                     break;
                 default:
@@ -314,9 +406,34 @@ void clear_screen(CHIP8 *chip) {
             chip->PC += 2;
             break;
     }
+
+    if (!chip->vip_timing) chip->cycles++;
+    else if ((opcode & 0xF000) != 0xD000) chip->cycles += vip_cycles(opcode);
+}
+
+// Таймер уменьшается на границе каждого такта (каждые cycles_per_tick
+// инструкций), поэтому его значение — исходное минус число пройденных границ
+static uint8_t timer_value(const CHIP8 *chip, uint8_t value, uint64_t set) {
+    uint64_t ticks = chip->cycles / chip->cycles_per_tick - set / chip->cycles_per_tick;
+    return ticks >= value ? 0 : (uint8_t)(value - ticks);
+}
+
+uint8_t delay_timer(const CHIP8 *chip) {
+    return timer_value(chip, chip->DT, chip->DT_set);
 }
 
-void update_timers(CHIP8 *chip) {
-    if (chip->DT > 0) chip->DT--;
-    if (chip->ST > 0) chip->ST--;
-}
\ No newline at end of file
+uint8_t sound_timer(const CHIP8 *chip) {
+    return timer_value(chip, chip->ST, chip->ST_set);
+}
+
+// Переключает счётчик времени между инструкциями и циклами VIP.
+// Вызывать до начала эмуляции: от масштаба зависят значения таймеров.
+void set_vip_timing(CHIP8 *chip, int on) {
+    chip->vip_timing = on != 0;
+    chip->cycles_per_tick = on ? VIP_CYCLES_PER_FRAME : INSTRUCTIONS_PER_FRAME;
+}
+
+// Задаёт начальное состояние ГСЧ; у xorshift состояние 0 недопустимо
+void seed_random(CHIP8 *chip, uint32_t seed) {
+    chip->rng = seed ? seed : DEFAULT_SEED;
+}
@@ -9,29 +9,63 @@
 #define SCREEN_HEIGHT 32
 #define SCREEN_WORDS (SCREEN_WIDTH * SCREEN_HEIGHT / 64) // 32
 #define MEMORY_SIZE 4096
+#define ADDR_MASK (MEMORY_SIZE - 1)     // Адреса I и PC берутся по модулю 4 КБ
+#define MEMORY_GUARD 16                 // Зеркало memory[0..15] после конца памяти
 #define STACK_SIZE 16
 #define REGISTERS_COUNT 16
 #define KEY_COUNT 16
+#define FRAME_RATE 60                   // Частота кадров эмуляции (и таймеров)
+#define INSTRUCTIONS_PER_FRAME 10
+#define ROM_START 0x200                 // Адрес загрузки программ
+#define DEFAULT_SEED 0x2545F491u        // Начальное состояние ГСЧ: прогоны воспроизводимы
+#define ALL_ROWS 0xFFFFFFFFu            // Маска «изменены все строки»
+#define VIP_CYCLES_PER_FRAME 3668       // Машинных циклов COSMAC VIP за кадр (1.76 МГц / 8 / 60)
+
+// Совместимость с разными интерпретаторами (профиль берётся из базы по хэшу ROM)
+#define QUIRK_SHIFT_VY    0x01  // 8xy6/8xyE сдвигают Vy, а не Vx (COSMAC VIP)
+#define QUIRK_LOAD_STORE  0x02  // Fx55/Fx65 увеличивают I (COSMAC VIP)
+#define QUIRK_JUMP_VX     0x04  // Bxnn прыгает на xnn + Vx (SUPER-CHIP)
 
 typedef struct CHIP8 {
     uint64_t display[SCREEN_WORDS]; // Экран (32x64) в битах
     uint16_t stack[STACK_SIZE];     // Стек
     uint16_t PC;                     // Счётчик команд
     uint16_t I;                       // Регистр адреса
-    uint8_t memory[MEMORY_SIZE];      // Память
+    // Память. За ней MEMORY_GUARD байт — копия её начала, поэтому обращение
+    // по адресу (I & ADDR_MASK) + k, k < 16, не выходит за массив и сразу
+    // даёт перенос через 0xFFF без проверок на каждый байт
+    uint8_t memory[MEMORY_SIZE + MEMORY_GUARD];
     uint8_t V[REGISTERS_COUNT];       // Регистры V0-VF
     uint8_t SP;                        // Указатель стека
-    uint8_t DT;                         // Таймер задержки
-    volatile uint8_t ST;                 // Звуковой таймер
+    // Таймеры хранятся как (значение, такт установки) и вычисляются по
+    // требованию: delay_timer()/sound_timer(). Декремента на каждом кадре нет.
+    uint8_t DT;                         // Таймер задержки в момент установки
+    uint8_t ST;                          // Звуковой таймер в момент установки
+    uint64_t DT_set;                     // chip->cycles в момент записи DT
+    uint64_t ST_set;                     // chip->cycles в момент записи ST
+    // Счётчик времени: инструкции, а в режиме VIP — машинные циклы VIP
+    uint64_t cycles;                     // Прошло с начала
+    uint32_t cycles_per_tick;            // На такт таймеров и кадр (60 Гц)
+    uint8_t vip_timing;                  // Стоимость инструкций как на COSMAC VIP
+    uint64_t dt_wait;                    // Время в циклах опроса DT, пока он не истёк
+    uint64_t dt_poll_at;                 // Время последнего Fx07 с DT > 0
+    uint16_t dt_poll_pc;                 // и его адрес
     uint8_t keys[KEY_COUNT];             // Состояние клавиш
-    uint8_t draw_flag;                    // Флаг обновления экрана
+    uint32_t dirty_rows;                  // Маска изменённых строк экрана (бит y = строка y)
+    uint8_t quirks;                       // Флаги QUIRK_*
+    uint64_t rom_hash;                    // xxHash64 загруженного ROM
+    uint32_t rng;                         // Состояние xorshift32 для Cxkk, не 0
 } CHIP8;
 
 void initialize(CHIP8 *chip);
 int load_rom(CHIP8 *chip, const char *filename);
+void rom_loaded(CHIP8 *chip, int size);
 uint16_t fetch_opcode(CHIP8 *chip);
 void clear_screen(CHIP8 *chip);
 void execute(CHIP8 *chip, uint16_t opcode);
-void update_timers(CHIP8 *chip);
+uint8_t delay_timer(const CHIP8 *chip);
+uint8_t sound_timer(const CHIP8 *chip);
+void set_vip_timing(CHIP8 *chip, int on);
+void seed_random(CHIP8 *chip, uint32_t seed);
 
 #endif
\ No newline at end of file
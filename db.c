@@ -1,16 +1,117 @@
 #include "db.h"
+#include "hash.h"
 #include <sqlite3.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-sqlite3* init_db(const char *db_name) {
-    sqlite3 *db;
-    int rc = sqlite3_open(db_name, &db);
+// Настройки соединения: WAL и ослабленный fsync (целостность сохраняется,
+// теряется лишь последняя транзакция при сбое питания), кэш и mmap побольше
+static const char *sql_pragmas =
+    "PRAGMA journal_mode = WAL;"
+    "PRAGMA synchronous = NORMAL;"
+    "PRAGMA temp_store = MEMORY;"
+    "PRAGMA cache_size = -8192;"        // 8 МБ
+    "PRAGMA mmap_size = 67108864;";     // 64 МБ
+
+static int exec_sql(sqlite3 *db, const char *sql) {
+    char *errmsg = NULL;
+    int rc = sqlite3_exec(db, sql, NULL, NULL, &errmsg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", errmsg);
+        sqlite3_free(errmsg);
+    }
+    return rc;
+}
+
+static int prepare(sqlite3 *db, const char *sql, sqlite3_stmt **stmt) {
+    int rc = sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+    }
+    return rc;
+}
+
+// Столбцы, появившиеся после первой версии схемы
+static const char *added_columns[][2] = {
+    { "rom", "BLOB" },
+    { "rom_hash", "INTEGER" },
+    { "ips", "INTEGER" },
+    { "quirks", "INTEGER" },
+    { "keymap", "TEXT" },
+    { "color_on", "INTEGER" },
+    { "color_off", "INTEGER" },
+};
+
+// Добавляет недостающие столбцы в базы, созданные старыми версиями.
+// *added_hash = 1, если пришлось добавить rom или rom_hash — тогда ROM
+// существующих игр нужно импортировать (это делает init_db)
+static int migrate(sqlite3 *db, int *added_hash) {
+    char sql[128];
+    for (size_t i = 0; i < sizeof(added_columns) / sizeof(added_columns[0]); i++) {
+        sqlite3_stmt *stmt;
+        snprintf(sql, sizeof(sql), "SELECT %s FROM games LIMIT 0;", added_columns[i][0]);
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+            sqlite3_finalize(stmt);
+            continue;
+        }
+        snprintf(sql, sizeof(sql), "ALTER TABLE games ADD COLUMN %s %s;",
+                 added_columns[i][0], added_columns[i][1]);
+        int rc = exec_sql(db, sql);
+        if (rc != SQLITE_OK) return rc;
+        if (i < 2) *added_hash = 1;     // rom, rom_hash
+    }
+    return exec_sql(db, "CREATE INDEX IF NOT EXISTS games_rom_hash ON games(rom_hash);");
+}
+
+// Полнотекстовый индекс FTS5 по name/author/description. Таблица
+// external-content: тексты хранятся только в games, а индекс
+// поддерживается триггерами
+static const char *sql_fts =
+    "CREATE VIRTUAL TABLE games_fts USING fts5("
+    "name, author, description, content='games', content_rowid='id');"
+    "CREATE TRIGGER IF NOT EXISTS games_fts_ai AFTER INSERT ON games BEGIN "
+    "INSERT INTO games_fts(rowid, name, author, description) "
+    "VALUES (new.id, new.name, new.author, new.description); END;"
+    "CREATE TRIGGER IF NOT EXISTS games_fts_ad AFTER DELETE ON games BEGIN "
+    "INSERT INTO games_fts(games_fts, rowid, name, author, description) "
+    "VALUES ('delete', old.id, old.name, old.author, old.description); END;"
+    "CREATE TRIGGER IF NOT EXISTS games_fts_au AFTER UPDATE OF name, author, description ON games BEGIN "
+    "INSERT INTO games_fts(games_fts, rowid, name, author, description) "
+    "VALUES ('delete', old.id, old.name, old.author, old.description); "
+    "INSERT INTO games_fts(rowid, name, author, description) "
+    "VALUES (new.id, new.name, new.author, new.description); END;"
+    "INSERT INTO games_fts(games_fts) VALUES ('rebuild');";  // Уже существующие игры
+
+static int create_fts(sqlite3 *db) {
+    sqlite3_stmt *stmt;
+    int exists = 0;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE name = 'games_fts';",
+                           -1, &stmt, NULL) == SQLITE_OK) {
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+    }
+    if (exists) return SQLITE_OK;
+
+    int rc = exec_sql(db, "BEGIN;");
+    if (rc == SQLITE_OK) rc = exec_sql(db, sql_fts);
+    exec_sql(db, rc == SQLITE_OK ? "COMMIT;" : "ROLLBACK;");
+    return rc;
+}
+
+GameDB* init_db(const char *db_name) {
+    GameDB *gdb = calloc(1, sizeof(GameDB));
+    if (!gdb) return NULL;
+
+    int rc = sqlite3_open(db_name, &gdb->db);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(gdb->db));
+        sqlite3_close(gdb->db);
+        free(gdb);
         return NULL;
     }
+    sqlite3_busy_timeout(gdb->db, 2000);
+    int migrated = 0;
     
     const char *sql_create = 
         "CREATE TABLE IF NOT EXISTS games ("
@@ -19,30 +120,67 @@ sqlite3* init_db(const char *db_name) {
         "path TEXT NOT NULL,"
         "author TEXT,"
         "year INTEGER,"
-        "description TEXT"
+        "description TEXT,"
+        "rom BLOB,"                     // Сам ROM, чтобы библиотека была одним файлом
+        "rom_hash INTEGER,"             // xxHash64 ROM
+        "ips INTEGER,"                  // Настройки игры по умолчанию
+        "quirks INTEGER,"
+        "keymap TEXT,"
+        "color_on INTEGER,"
+        "color_off INTEGER"
         ");";
     
-    char *errmsg = NULL;
-    rc = sqlite3_exec(db, sql_create, NULL, NULL, &errmsg);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "SQL error: %s\n", errmsg);
-        sqlite3_free(errmsg);
-        sqlite3_close(db);
+    if (exec_sql(gdb->db, sql_pragmas) != SQLITE_OK ||
+        exec_sql(gdb->db, sql_create) != SQLITE_OK ||
+        migrate(gdb->db, &migrated) != SQLITE_OK ||
+        prepare(gdb->db, "SELECT path FROM games WHERE id = ?;", &gdb->get_path) != SQLITE_OK ||
+        prepare(gdb->db, "INSERT INTO games (name, path, author, year, description) VALUES (?, ?, ?, ?, ?);",
+                &gdb->insert) != SQLITE_OK ||
+        prepare(gdb->db, "SELECT COUNT(*) FROM games;", &gdb->count) != SQLITE_OK ||
+        prepare(gdb->db, "UPDATE games SET rom = ?, rom_hash = ? WHERE id = ?;", &gdb->store_rom) != SQLITE_OK ||
+        prepare(gdb->db, "SELECT ips, quirks, keymap, color_on, color_off FROM games "
+                         "WHERE rom_hash = ? LIMIT 1;", &gdb->find_config) != SQLITE_OK ||
+        prepare(gdb->db, "SELECT 1 FROM games WHERE rom_hash = ? LIMIT 1;", &gdb->has_rom) != SQLITE_OK) {
+        close_db(gdb);
         return NULL;
     }
+
+    // Полнотекстовый поиск необязателен: без FTS5 в SQLite работает всё,
+    // кроме команды search (gdb->search остаётся NULL)
+    if (create_fts(gdb->db) != SQLITE_OK ||
+        prepare(gdb->db, "SELECT g.id, g.name, g.author, g.year, bm25(games_fts) AS rank "
+                         "FROM games_fts JOIN games g ON g.id = games_fts.rowid "
+                         "WHERE games_fts MATCH ? ORDER BY rank LIMIT ?;", &gdb->search) != SQLITE_OK) {
+        fprintf(stderr, "Warning: full-text search disabled (SQLite without FTS5?)\n");
+        sqlite3_finalize(gdb->search);
+        gdb->search = NULL;
+    }
+
+    // База создана до появления rom_hash: импортируем ROM существующих игр
+    // сразу, пока известно, что миграция только что прошла. Иначе
+    // db_find_config() не нашёл бы их ни у одного вызывающего init_db
+    if (migrated) db_embed_roms(gdb);
     
-    return db;
+    return gdb;
 }
 
-char* get_rom_path(sqlite3 *db, int id) {
-    sqlite3_stmt *stmt;
-    const char *sql = "SELECT path FROM games WHERE id = ?;";
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+// Лёгкое открытие только для поиска настроек по хэшу: без создания схемы,
+// миграций и заполнения. Если файла базы нет, SQLite ничего не создаёт.
+GameDB* open_db_readonly(const char *db_name) {
+    GameDB *gdb = calloc(1, sizeof(GameDB));
+    if (!gdb) return NULL;
+
+    if (sqlite3_open_v2(db_name, &gdb->db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(gdb->db, "SELECT ips, quirks, keymap, color_on, color_off FROM games "
+                                    "WHERE rom_hash = ? LIMIT 1;", -1, &gdb->find_config, NULL) != SQLITE_OK) {
+        close_db(gdb);  // Нет базы или старая схема — просто работаем без неё
         return NULL;
     }
-    
+    return gdb;
+}
+
+char* get_rom_path(GameDB *gdb, int id) {
+    sqlite3_stmt *stmt = gdb->get_path;
     sqlite3_bind_int(stmt, 1, id);
     
     char *path = NULL;
@@ -54,49 +192,260 @@ char* get_rom_path(sqlite3 *db, int id) {
         }
     }
     
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     return path;
 }
 
-int add_game(sqlite3 *db, const char *name, const char *path, const char *author, int year, const char *description) {
-    sqlite3_stmt *stmt;
-    const char *sql = "INSERT INTO games (name, path, author, year, description) VALUES (?, ?, ?, ?, ?);";
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Prepare error: %s\n", sqlite3_errmsg(db));
-        return -1;
-    }
-    
+int add_game(GameDB *gdb, const char *name, const char *path, const char *author, int year, const char *description) {
+    sqlite3_stmt *stmt = gdb->insert;
     sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 3, author, -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 4, year);
     sqlite3_bind_text(stmt, 5, description, -1, SQLITE_STATIC);
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
     
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
-void close_db(sqlite3 *db) {
-    if (db) sqlite3_close(db);
+// Читает ROM из столбца rom прямо в dst (обычно &chip->memory[ROM_START]),
+// без промежуточных копий. Возвращает размер, 0 если ROM в базе нет,
+// -1 если он не помещается или чтение не удалось.
+int db_load_rom(GameDB *gdb, int id, uint8_t *dst, int max_size) {
+    sqlite3_blob *blob;
+    // Для NULL (ROM ещё не импортирован) открыть blob нельзя — это не ошибка
+    if (sqlite3_blob_open(gdb->db, "main", "games", "rom", id, 0, &blob) != SQLITE_OK) {
+        return 0;
+    }
+    int size = sqlite3_blob_bytes(blob);
+    int rc = -1;
+    if (size > max_size) {
+        printf("Error: ROM too large\n");
+    } else if (sqlite3_blob_read(blob, dst, size, 0) == SQLITE_OK) {
+        rc = size;
+    } else {
+        fprintf(stderr, "Blob read error: %s\n", sqlite3_errmsg(gdb->db));
+    }
+    sqlite3_blob_close(blob);
+    return rc;
 }
 
-void populate_default_games(sqlite3 *db) {
+// Загрузка игры по id: сначала из столбца rom (одно открытие файла базы),
+// для ещё не импортированных игр — по пути из столбца path
+int load_game(GameDB *gdb, int id, CHIP8 *chip) {
+    int size = db_load_rom(gdb, id, &chip->memory[ROM_START], MEMORY_SIZE - ROM_START);
+    if (size > 0) {
+        rom_loaded(chip, size);
+        printf("Loaded ROM: game %d from database (%d bytes)\n", id, size);
+        return 1;
+    }
+    if (size < 0) return 0;
+
+    char *path = get_rom_path(gdb, id);
+    if (!path) {
+        printf("Game with ID %d not found in database.\n", id);
+        return 0;
+    }
+    int loaded = load_rom(chip, path);
+    free(path);
+    return loaded;
+}
+
+// hash — xxh64(data, size, 0), уже посчитанный вызывающим
+int db_store_rom(GameDB *gdb, int id, const void *data, int size, uint64_t hash) {
+    sqlite3_stmt *stmt = gdb->store_rom;
+    sqlite3_bind_blob(stmt, 1, data, size, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, (sqlite3_int64)hash);
+    sqlite3_bind_int(stmt, 3, id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return (rc == SQLITE_DONE) ? 0 : -1;
+}
+
+// Импорт: для всех игр без ROM (или без хэша) в базе читает файл по path
+// и сохраняет его в столбец rom вместе с хэшем. Возвращает число
+// импортированных ROM.
+int db_embed_roms(GameDB *gdb) {
     sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM games;", -1, &stmt, NULL);
-    int count = 0;
+    if (sqlite3_prepare_v2(gdb->db, "SELECT id, path FROM games WHERE rom IS NULL OR rom_hash IS NULL;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(gdb->db));
+        return -1;
+    }
+
+    int embedded = 0;
+    uint8_t buf[MEMORY_SIZE - ROM_START];  // Больше в память не загрузить
+    db_begin(gdb);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int id = sqlite3_column_int(stmt, 0);
+        const char *path = (const char*)sqlite3_column_text(stmt, 1);
+        FILE *file = path ? fopen(path, "rb") : NULL;
+        if (!file) {
+            printf("Warning: cannot open %s, skipped\n", path ? path : "(null)");
+            continue;
+        }
+        size_t size = fread(buf, 1, sizeof(buf), file);
+        int too_large = fgetc(file) != EOF;
+        fclose(file);
+        if (too_large) {
+            printf("Warning: %s is too large, skipped\n", path);
+            continue;
+        }
+        if (db_store_rom(gdb, id, buf, (int)size, xxh64(buf, size, 0)) == 0) embedded++;
+    }
+    db_commit(gdb);
+    sqlite3_finalize(stmt);
+    return embedded;
+}
+
+// Есть ли в библиотеке ROM с таким хэшем
+int db_has_rom(GameDB *gdb, uint64_t rom_hash) {
+    sqlite3_bind_int64(gdb->has_rom, 1, (sqlite3_int64)rom_hash);
+    int found = sqlite3_step(gdb->has_rom) == SQLITE_ROW;
+    sqlite3_reset(gdb->has_rom);
+    return found;
+}
+
+// Настройки игры по хэшу ROM — один запрос по индексу games_rom_hash,
+// независимо от того, где лежит файл и как он называется.
+// Возвращает 1, если игра найдена.
+int db_find_config(GameDB *gdb, uint64_t rom_hash, RomConfig *cfg) {
+    sqlite3_stmt *stmt = gdb->find_config;
+    memset(cfg, 0, sizeof(*cfg));
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)rom_hash);
+
+    int found = 0;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        count = sqlite3_column_int(stmt, 0);
+        found = 1;
+        cfg->ips = sqlite3_column_int(stmt, 0);
+        cfg->quirks = sqlite3_column_int(stmt, 1);
+        const char *keymap = (const char*)sqlite3_column_text(stmt, 2);
+        if (keymap && strlen(keymap) == 16) memcpy(cfg->keymap, keymap, 17);
+        cfg->color_on = (uint32_t)sqlite3_column_int64(stmt, 3);
+        cfg->color_off = (uint32_t)sqlite3_column_int64(stmt, 4);
+    }
+    sqlite3_reset(stmt);
+    return found;
+}
+
+// Сохраняет скорость для всех записей с этим ROM; её подхватит
+// db_find_config() при следующем запуске. Возвращает число обновлённых
+// записей (0 — ROM нет в библиотеке) или -1.
+int db_store_ips(GameDB *gdb, uint64_t rom_hash, int ips) {
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(gdb->db, "UPDATE games SET ips = ? WHERE rom_hash = ?;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(gdb->db));
+        return -1;
     }
+    sqlite3_bind_int(stmt, 1, ips);
+    sqlite3_bind_int64(stmt, 2, (sqlite3_int64)rom_hash);
+    int rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    return (rc == SQLITE_DONE) ? sqlite3_changes(gdb->db) : -1;
+}
+
+// Поиск по названию, автору и описанию — один запрос к индексу FTS5.
+// Каждое слово запроса ищется как префикс ("tet" найдёт Tetris), спецсимволы
+// FTS5 экранируются. Возвращает число найденных игр или -1.
+int db_search(GameDB *gdb, const char *query, int limit, SearchCallback cb, void *ctx) {
+    if (!gdb->search) {
+        fprintf(stderr, "Full-text search is unavailable: SQLite was built without FTS5\n");
+        return -1;
+    }
+    size_t len = strlen(query);
+    char *match = malloc(len * 2 + 4 * len + 1);   // С запасом на кавычки и '*'
+    if (!match) return -1;
+
+    char *out = match;
+    const char *p = query;
+    while (*p) {
+        while (*p == ' ' || *p == '\t') p++;
+        if (!*p) break;
+        if (out != match) *out++ = ' ';
+        *out++ = '"';
+        while (*p && *p != ' ' && *p != '\t') {
+            if (*p == '"') *out++ = '"';            // Кавычка внутри строки FTS5 удваивается
+            *out++ = *p++;
+        }
+        *out++ = '"';
+        *out++ = '*';
+    }
+    *out = '\0';
+    if (out == match) {
+        free(match);
+        return 0;
+    }
+
+    sqlite3_stmt *stmt = gdb->search;
+    sqlite3_bind_text(stmt, 1, match, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, limit);
+    free(match);
+
+    int found = 0, rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        cb(ctx, sqlite3_column_int(stmt, 0),
+           (const char*)sqlite3_column_text(stmt, 1),
+           (const char*)sqlite3_column_text(stmt, 2),
+           sqlite3_column_int(stmt, 3),
+           sqlite3_column_double(stmt, 4));
+        found++;
+    }
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Search error: %s\n", sqlite3_errmsg(gdb->db));
+        found = -1;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return found;
+}
+
+// Пакетные вставки оборачиваются в одну транзакцию: один fsync на пакет
+int db_begin(GameDB *gdb) {
+    return exec_sql(gdb->db, "BEGIN IMMEDIATE;") == SQLITE_OK ? 0 : -1;
+}
+
+int db_commit(GameDB *gdb) {
+    return exec_sql(gdb->db, "COMMIT;") == SQLITE_OK ? 0 : -1;
+}
+
+void close_db(GameDB *gdb) {
+    if (!gdb) return;
+    sqlite3_finalize(gdb->get_path);
+    sqlite3_finalize(gdb->insert);
+    sqlite3_finalize(gdb->count);
+    sqlite3_finalize(gdb->store_rom);
+    sqlite3_finalize(gdb->find_config);
+    sqlite3_finalize(gdb->has_rom);
+    sqlite3_finalize(gdb->search);
+    sqlite3_close(gdb->db);
+    free(gdb);
+}
+
+void populate_default_games(GameDB *gdb) {
+    int count = 0;
+    if (sqlite3_step(gdb->count) == SQLITE_ROW) {
+        count = sqlite3_column_int(gdb->count, 0);
+    }
+    sqlite3_reset(gdb->count);
     
     if (count == 0) {
-        add_game(db, "Pong", "roms/pong.ch8", "Nolan Bushnell", 1972, "Classic Pong");
-        add_game(db, "Space Invaders", "roms/invaders.ch8", "Tomohiro Nishikado", 1978, "Space Invaders");
-        add_game(db, "Tetris", "roms/tetris.ch8", "Alexey Pajitnov", 1984, "Tetris");
-        add_game(db, "Brix", "roms/brix.ch8", "Andreas Gustafsson", 0, "Breakout clone");
-        add_game(db, "IBM", "roms/ibm.ch8", "Unknown", 1981, "IBM logo demo");
+        db_begin(gdb);
+        add_game(gdb, "Pong", "roms/pong.ch8", "Nolan Bushnell", 1972, "Classic Pong");
+        add_game(gdb, "Space Invaders", "roms/invaders.ch8", "Tomohiro Nishikado", 1978, "Space Invaders");
+        add_game(gdb, "Tetris", "roms/tetris.ch8", "Alexey Pajitnov", 1984, "Tetris");
+        add_game(gdb, "Brix", "roms/brix.ch8", "Andreas Gustafsson", 0, "Breakout clone");
+        add_game(gdb, "IBM", "roms/ibm.ch8", "Unknown", 1981, "IBM logo demo");
+        db_commit(gdb);
     }
+
+    // ROM только что добавленных игр импортируем сразу (базы старых версий
+    // дополняет init_db). В остальных случаях это делает лишь команда
+    // embed: иначе каждое открытие брало бы транзакцию на запись
+    // и повторяло предупреждения о недоступных файлах
+    if (count == 0) db_embed_roms(gdb);
 }
\ No newline at end of file
@@ -2,11 +2,50 @@
 #define DB_H
 
 #include <sqlite3.h>
+#include <stdint.h>
+#include "chip8.h"
 
-sqlite3* init_db(const char *db_name);
-char* get_rom_path(sqlite3 *db, int id);
-int add_game(sqlite3 *db, const char *name, const char *path, const char *author, int year, const char *description);
-void close_db(sqlite3 *db);
-void populate_default_games(sqlite3 *db);
+// Настройки игры, найденные по хэшу ROM. Нулевые значения — «не задано»
+typedef struct RomConfig {
+    int ips;                // Инструкций в секунду
+    int quirks;             // Флаги QUIRK_*
+    char keymap[17];        // Клавиши хоста для клавиш CHIP-8 0..F, например "x123qweasdzc4rfv"
+    uint32_t color_on;      // Палитра, ARGB8888
+    uint32_t color_off;
+} RomConfig;
 
-#endif
\ No newline at end of file
+// Результат поиска; вызывается для каждой найденной игры по убыванию релевантности
+typedef void (*SearchCallback)(void *ctx, int id, const char *name, const char *author,
+                               int year, double rank);
+
+// Долгоживущее соединение с библиотекой игр: подготовленные запросы
+// создаются один раз при открытии и переиспользуются
+typedef struct GameDB {
+    sqlite3 *db;
+    sqlite3_stmt *get_path;   // SELECT path ... WHERE id = ?
+    sqlite3_stmt *insert;     // INSERT INTO games ...
+    sqlite3_stmt *count;      // SELECT COUNT(*) ...
+    sqlite3_stmt *store_rom;  // UPDATE games SET rom = ?, rom_hash = ? WHERE id = ?
+    sqlite3_stmt *find_config;// SELECT ... WHERE rom_hash = ? (по индексу)
+    sqlite3_stmt *has_rom;    // SELECT 1 ... WHERE rom_hash = ?
+    sqlite3_stmt *search;     // Полнотекстовый поиск по games_fts; NULL без FTS5
+} GameDB;
+
+GameDB* init_db(const char *db_name);
+GameDB* open_db_readonly(const char *db_name);
+char* get_rom_path(GameDB *gdb, int id);
+int add_game(GameDB *gdb, const char *name, const char *path, const char *author, int year, const char *description);
+int db_load_rom(GameDB *gdb, int id, uint8_t *dst, int max_size);
+int db_store_rom(GameDB *gdb, int id, const void *data, int size, uint64_t hash);
+int db_embed_roms(GameDB *gdb);
+int db_has_rom(GameDB *gdb, uint64_t rom_hash);
+int db_find_config(GameDB *gdb, uint64_t rom_hash, RomConfig *cfg);
+int db_store_ips(GameDB *gdb, uint64_t rom_hash, int ips);
+int load_game(GameDB *gdb, int id, CHIP8 *chip);
+int db_search(GameDB *gdb, const char *query, int limit, SearchCallback cb, void *ctx);
+int db_begin(GameDB *gdb);
+int db_commit(GameDB *gdb);
+void close_db(GameDB *gdb);
+void populate_default_games(GameDB *gdb);
+
+#endif
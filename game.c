@@ -2,81 +2,252 @@
 #include "sqlite3.h"
 #include "chip8.h"
 #include "db.h"
+#include "triplebuf.h"
+#include "spsc.h"
+#include "video.h"
+#include "beeper.h"
+#include "headless.h"
+#include "import.h"
+#include "tune.h"
+#include "stats.h"
+#include "perfcount.h"
+#include "trace.h"
+#include "hud.h"
+#include <stdatomic.h>
 #undef main
 
-#define SAMPLE_RATE 44100
-#define TONE_FREQUENCY 440.0
-#define AMPLITUDE 3000
 #define SCALE 10
+#define INPUT_QUEUE_SIZE 256
+#define AUDIO_BUFFER 256            // Сэмплов в буфере устройства (~5.8 мс)
+#define AUDIO_LATENCY 1024          // Отставание звука от эмуляции в сэмплах (~23 мс)
 
 static SDL_AudioDeviceID audio_dev;
-static double audio_phase = 0.0;
+static Beeper beeper;               // Синтезатор, питаемый фронтами от эмуляции
+static atomic_int emu_started = 0;  // Шкала времени эмуляции запущена
+static _Atomic int64_t emu_time = 0; // Докуда дошла эмуляция, в сэмплах
 
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
+SDL_Texture* screen_texture = NULL;  // Потоковая текстура 64x32 (или увеличенная)
 
+static ScaleFilter soft_filter = 0;  // Программное увеличение; 0 — масштабирует SDL
+static int texture_w = SCREEN_WIDTH, texture_h = SCREEN_HEIGHT;
+static uint32_t *soft_pixels = NULL; // Буфер программного увеличения
+
+static int phosphor_on = 0;          // Послесвечение вместо резкого XOR-мерцания
+static Phosphor phosphor;
+static Uint64 phosphor_ticks = 0, phosphor_max = 0, phosphor_frames = 0;
+
+// Настройки текущей игры (по умолчанию или из базы по хэшу ROM)
+#define DEFAULT_KEYMAP "x123qweasdzc4rfv"  // Клавиши хоста для CHIP-8 0..F
+static int ipf = INSTRUCTIONS_PER_FRAME;
+static int vip_timing = 0;                 // --vip: тайминги COSMAC VIP вместо ipf
+static int perf_on = 0;                    // --perf-counters
+static PerfCounters perf;                  // Открываются в потоке эмуляции
+static const char *trace_path = NULL;      // --trace: куда записать трассу фаз кадра
+static uint32_t color_on = COLOR_ON, color_off = COLOR_OFF;
+static int8_t key_table[128];              // Символ клавиши хоста -> клавиша CHIP-8
+
+static TripleBuffer frames;        // Кадры от потока эмуляции к потоку отрисовки
+static atomic_int running = 1;
+static int redraw_pending = 1;     // Окно нужно перерисовать целиком (expose и т.п.)
+
+// Оверлей производительности (F1). Поток эмуляции только накапливает
+// счётчики, всё остальное считает и рисует поток UI раз в HUD_REFRESH_MS
+#define HUD_REFRESH_MS 500
+#define HUD_SCALE 2
+static int hud_on = 0;
+static SDL_Texture *hud_texture = NULL;
+static FrameHistogram hud_hist;
+static _Atomic uint64_t emu_instructions = 0, emu_exec_ticks = 0, emu_frames = 0;
+static Uint64 render_start = 0;    // Начало отрисовки текущего кадра
+static Uint64 render_ticks = 0, render_count = 0;
+static uint32_t dropped_frames = 0;
+
+// Событие клавиатуры с меткой времени (в тиках SDL_GetPerformanceCounter)
+typedef struct InputEvent {
+    Uint64 timestamp;
+    uint8_t key;
+    uint8_t pressed;
+} InputEvent;
+
+static SpscRing input_queue;       // События от потока UI к потоку эмуляции
+
+ // Поток звука: синтезирует меандр по фронтам из очереди. Состояние
+ // эмулятора здесь не читается вовсе.
  void audio_callback(void *userdata, Uint8 *stream, int len) {
-    CHIP8 *chip = (CHIP8*)userdata;
+    Beeper *bp = (Beeper*)userdata;
     Sint16 *buffer = (Sint16*)stream;
     int samples = len / sizeof(Sint16);
 
-    for (int i = 0; i < samples; i++) {
-        // Читаем звуковой таймер 
-        if (chip->ST > 0) {
-            // Прямоугольный сигнал
-            buffer[i] = (audio_phase < 0.5) ? AMPLITUDE : -AMPLITUDE;
-            audio_phase += TONE_FREQUENCY / SAMPLE_RATE;
-            if (audio_phase >= 1.0)
-                audio_phase -= 1.0;
-        } else {
-            buffer[i] = 0;
-            audio_phase = 0.0; 
-        }
+    if (!atomic_load(&emu_started)) {
+        memset(stream, 0, len);
+        return;
     }
+    static int trace_named = 0;
+    if (trace_enabled && !trace_named) {
+        trace_thread_name("audio");
+        trace_named = 1;
+    }
+    uint64_t t = TRACE_BEGIN();
+    beeper_sync(bp, atomic_load(&emu_time), AUDIO_LATENCY);
+    beeper_render(bp, buffer, samples);
+    TRACE_END("audio render", t);
 }
 
- void init_audio(CHIP8 *chip) {
+ void init_audio(void) {
     SDL_AudioSpec desired, obtained;
     SDL_zero(desired);
     desired.freq = SAMPLE_RATE;
     desired.format = AUDIO_S16SYS;  // 16-битные сэмплы, системный порядок байт
     desired.channels = 1;            // Моно
-    desired.samples = 2048;          // Размер буфера 
+    desired.samples = AUDIO_BUFFER;  // Маленький буфер — низкая задержка
     desired.callback = audio_callback;
-    desired.userdata = chip;
+    desired.userdata = &beeper;
+
+    // Звук отстаёт от эмуляции на AUDIO_LATENCY: фронты кадра успевают
+    // попасть в очередь раньше, чем до них дойдёт синтез
+    if (!beeper_init(&beeper, SAMPLE_RATE, TONE_FREQUENCY, AMPLITUDE)) {
+        printf("Warning: cannot allocate audio queue\n");
+        return;
+    }
+    beeper.pos = -AUDIO_LATENCY;
 
     audio_dev = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, 0);
     if (audio_dev == 0) {
         printf("Warning: cannot open audio device: %s\n", SDL_GetError());
+        beeper_free(&beeper);  // Без устройства очередь не нужна, а при выходе её уже не освободят
     } else {
         SDL_PauseAudioDevice(audio_dev, 0);  // Снимаем с паузы
     }
 }
 
- void handle_input(CHIP8 *chip) {
+ // Раскладка клавиатуры: keymap[k] — клавиша хоста для клавиши CHIP-8 k
+static void set_keymap(const char *keymap) {
+    memset(key_table, -1, sizeof(key_table));
+    for (int k = 0; k < KEY_COUNT; k++) {
+        unsigned char c = (unsigned char)keymap[k];
+        if (c < sizeof(key_table)) key_table[c] = (int8_t)k;
+    }
+}
+
+// Клавиша SDL -> клавиша CHIP-8, -1 если не назначена
+// (коды SDL для цифр и букв совпадают с ASCII)
+static int map_key(SDL_Keycode sym) {
+    if (sym < 0 || sym >= (SDL_Keycode)sizeof(key_table)) return -1;
+    return key_table[sym];
+}
+
+// Применяет настройки игры, найденные в базе
+static void apply_config(CHIP8 *chip, const RomConfig *cfg) {
+    if (cfg->ips > 0) {
+        ipf = cfg->ips / FRAME_RATE;
+        if (ipf < 1) ipf = 1;
+    }
+    if (!chip->vip_timing) chip->cycles_per_tick = ipf;
+    chip->quirks = (uint8_t)cfg->quirks;
+    if (cfg->keymap[0]) set_keymap(cfg->keymap);
+    if (cfg->color_on || cfg->color_off) {
+        color_on = cfg->color_on;
+        color_off = cfg->color_off;
+    }
+    if (chip->vip_timing) printf("Config: VIP timing, quirks 0x%02X\n", chip->quirks);
+    else printf("Config: %d IPS, quirks 0x%02X\n", ipf * FRAME_RATE, chip->quirks);
+}
+
+static void toggle_hud(void) {
+    if (!hud_texture) {
+        hud_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                        SDL_TEXTUREACCESS_STREAMING, HUD_WIDTH, HUD_HEIGHT);
+        if (!hud_texture) {
+            printf("SDL texture error: %s\n", SDL_GetError());
+            return;
+        }
+        SDL_SetTextureBlendMode(hud_texture, SDL_BLENDMODE_BLEND);
+        // До первого пересчёта показываем нули, а не мусор из текстуры
+        HudStats empty = { 0 };
+        void *pixels;
+        int pitch;
+        if (SDL_LockTexture(hud_texture, NULL, &pixels, &pitch) == 0) {
+            hud_render(pixels, pitch / (int)sizeof(uint32_t), &empty, &hud_hist);
+            SDL_UnlockTexture(hud_texture);
+        }
+        printf("HUD: C ips, F frame p50/p99 us, E execute us, B render us, "
+               "A audio fill, D dropped frames\n");
+    }
+    hud_on = !hud_on;
+    hist_reset(&hud_hist);
+    redraw_pending = 1;
+}
+
+// Пересчитывает показатели оверлея за прошедший интервал и рисует его
+static void update_hud(Uint64 now) {
+    static Uint64 last = 0, last_instr = 0, last_exec = 0, last_frames = 0;
+    static Uint64 last_render = 0, last_render_count = 0;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    if (last && now - last < freq * HUD_REFRESH_MS / 1000) return;
+
+    Uint64 instr = atomic_load_explicit(&emu_instructions, memory_order_relaxed);
+    Uint64 exec = atomic_load_explicit(&emu_exec_ticks, memory_order_relaxed);
+    Uint64 frames_done = atomic_load_explicit(&emu_frames, memory_order_relaxed);
+    if (last) {
+        double sec = (double)(now - last) / freq;
+        Uint64 df = frames_done - last_frames, dr = render_count - last_render_count;
+        HudStats st = {
+            .ips = (uint32_t)((instr - last_instr) / sec),
+            .frame_p50 = hist_percentile(&hud_hist, 50),
+            .frame_p99 = hist_percentile(&hud_hist, 99),
+            .exec_us = df ? (uint32_t)((exec - last_exec) * 1000000 / freq / df) : 0,
+            .render_us = dr ? (uint32_t)((render_ticks - last_render) * 1000000 / freq / dr) : 0,
+            .audio_fill = audio_dev ? atomic_load(&beeper.fill) : 0,
+            .dropped = dropped_frames
+        };
+        void *pixels;
+        int pitch;
+        if (SDL_LockTexture(hud_texture, NULL, &pixels, &pitch) == 0) {
+            hud_render(pixels, pitch / (int)sizeof(uint32_t), &st, &hud_hist);
+            SDL_UnlockTexture(hud_texture);
+        }
+        hist_reset(&hud_hist);
+    }
+    last = now;
+    last_instr = instr;
+    last_exec = exec;
+    last_frames = frames_done;
+    last_render = render_ticks;
+    last_render_count = render_count;
+}
+
+ // Вызывается в потоке UI: состояние клавиш не трогаем, а ставим
+ // события в очередь для потока эмуляции
+ void handle_input(void) {
     SDL_Event e;
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint32 ticks = SDL_GetTicks();
+
     while (SDL_PollEvent(&e)) {
-        if (e.type == SDL_QUIT) exit(0);
+        if (e.type == SDL_QUIT) atomic_store(&running, 0);
+        if (e.type == SDL_WINDOWEVENT) redraw_pending = 1;
 
+        if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F1 && !e.key.repeat) {
+            toggle_hud();
+            continue;
+        }
         if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
-            int pressed = (e.type == SDL_KEYDOWN);
-            switch (e.key.keysym.sym) {
-                case SDLK_1: chip->keys[0x1] = pressed; break;
-                case SDLK_2: chip->keys[0x2] = pressed; break;
-                case SDLK_3: chip->keys[0x3] = pressed; break;
-                case SDLK_4: chip->keys[0xC] = pressed; break;
-                case SDLK_q: chip->keys[0x4] = pressed; break;
-                case SDLK_w: chip->keys[0x5] = pressed; break;
-                case SDLK_e: chip->keys[0x6] = pressed; break;
-                case SDLK_r: chip->keys[0xD] = pressed; break;
-                case SDLK_a: chip->keys[0x7] = pressed; break;
-                case SDLK_s: chip->keys[0x8] = pressed; break;
-                case SDLK_d: chip->keys[0x9] = pressed; break;
-                case SDLK_f: chip->keys[0xE] = pressed; break;
-                case SDLK_z: chip->keys[0xA] = pressed; break;
-                case SDLK_x: chip->keys[0x0] = pressed; break;
-                case SDLK_c: chip->keys[0xB] = pressed; break;
-                case SDLK_v: chip->keys[0xF] = pressed; break;
+            int key = map_key(e.key.keysym.sym);
+            if (key < 0 || e.key.repeat) continue;
+
+            // Переводим миллисекундную метку события в шкалу счётчика
+            Uint32 age = ticks - e.key.timestamp;
+            if (age > 1000) age = 0;
+            InputEvent ev = {
+                now - (Uint64)age * freq / 1000,
+                (uint8_t)key,
+                (uint8_t)(e.type == SDL_KEYDOWN)
+            };
+            if (!spsc_push(&input_queue, &ev)) {
+                printf("Warning: input queue overflow\n");
             }
         }
     }
@@ -108,44 +279,441 @@ bool init_SDL() {
     return true;
 }
 
-void draw_screen(CHIP8 *chip) {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
-    
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-    
-    for (int y = 0; y < SCREEN_HEIGHT; y++) {
-        uint64_t row = chip->display[y]; 
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
-            if (row & (1ULL << x)) {
-                SDL_Rect rect = {
-                    x * SCALE,
-                    y * SCALE,
-                    SCALE,
-                    SCALE
-                };
-                SDL_RenderFillRect(renderer, &rect);
+// Вывод кадра: поверх экрана — оверлей, если он включён
+static void present(void) {
+    render_ticks += SDL_GetPerformanceCounter() - render_start;
+    render_count++;
+    if (hud_on && hud_texture) {
+        SDL_Rect dst = { 4, 4, HUD_WIDTH * HUD_SCALE, HUD_HEIGHT * HUD_SCALE };
+        SDL_RenderCopy(renderer, hud_texture, NULL, &dst);
+    }
+    uint64_t t = TRACE_BEGIN();
+    SDL_RenderPresent(renderer);
+    TRACE_END("present", t);
+}
+
+// Экран разворачивается в потоковую текстуру и выводится одним
+// масштабированным SDL_RenderCopy — стоимость не зависит от числа пикселей.
+// Заново разворачиваются и загружаются только строки из dirty_rows.
+void draw_screen(const uint64_t *display, uint32_t dirty_rows) {
+    static uint32_t staging[SCREEN_HEIGHT * SCREEN_WIDTH];
+
+    // Фильтры смотрят на соседние строки — расширяем маску на одну строку
+    if (soft_filter > FILTER_NEAREST) {
+        dirty_rows |= (dirty_rows << 1) | (dirty_rows >> 1);
+    }
+    int rows_per_line = texture_h / SCREEN_HEIGHT;
+
+    int y = 0;
+    while (y < SCREEN_HEIGHT) {
+        if (!(dirty_rows & (1u << y))) {
+            y++;
+            continue;
+        }
+        // Непрерывный отрезок изменённых строк загружаем одним вызовом
+        int first = y;
+        while (y < SCREEN_HEIGHT && (dirty_rows & (1u << y))) {
+            if (soft_filter) {
+                upscale_row(display, y, soft_filter, SCALE,
+                            &soft_pixels[(long)y * rows_per_line * texture_w],
+                            texture_w * sizeof(uint32_t), color_on, color_off);
+            } else {
+                expand_row(display[y], &staging[y * SCREEN_WIDTH], color_on, color_off);
             }
+            y++;
+        }
+        if (soft_filter) {
+            SDL_Rect rect = { 0, first * rows_per_line, texture_w, (y - first) * rows_per_line };
+            SDL_UpdateTexture(screen_texture, &rect,
+                              &soft_pixels[(long)first * rows_per_line * texture_w],
+                              texture_w * sizeof(uint32_t));
+        } else {
+            SDL_Rect rect = { 0, first, SCREEN_WIDTH, y - first };
+            SDL_UpdateTexture(screen_texture, &rect, &staging[first * SCREEN_WIDTH],
+                              SCREEN_WIDTH * sizeof(uint32_t));
         }
     }
-    
-    SDL_RenderPresent(renderer);
-    chip->draw_flag = 0;
+
+    if (soft_filter) {
+        // Готовое изображение копируется 1:1 по центру окна, без масштабирования
+        SDL_Rect dst = {
+            (SCREEN_WIDTH * SCALE - texture_w) / 2,
+            (SCREEN_HEIGHT * SCALE - texture_h) / 2,
+            texture_w,
+            texture_h
+        };
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, screen_texture, NULL, &dst);
+    } else {
+        SDL_RenderCopy(renderer, screen_texture, NULL, NULL);
+    }
+    present();
 }
 
-int main(int argc, char *argv[]) {
+// Отрисовка с послесвечением: затухание делает steps шагов — по одному на
+// каждый кадр эмуляции с прошлого вызова, так что скорость гашения не
+// зависит от частоты обновления монитора. Заново разворачиваются и
+// загружаются только строки, где яркость изменилась
+void draw_phosphor(const uint64_t *display, int steps) {
+    static uint32_t staging[SCREEN_HEIGHT * SCREEN_WIDTH];
+
+    // За PHOSPHOR_MAX_STEPS шагов гаснет даже полная яркость — дальше незачем
+    if (steps > PHOSPHOR_MAX_STEPS) steps = PHOSPHOR_MAX_STEPS;
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    uint32_t rows = 0;
+    for (int i = 0; i < steps; i++) rows |= phosphor_update(&phosphor, display);
+    Uint64 spent = SDL_GetPerformanceCounter() - t0;
+    phosphor_ticks += spent;
+    if (spent > phosphor_max) phosphor_max = spent;
+    phosphor_frames++;
+
+    int y = 0;
+    while (y < SCREEN_HEIGHT) {
+        if (!(rows & (1u << y))) {
+            y++;
+            continue;
+        }
+        // Непрерывный отрезок изменённых строк загружаем одним вызовом
+        int first = y;
+        while (y < SCREEN_HEIGHT && (rows & (1u << y))) {
+            phosphor_expand_row(&phosphor, y, &staging[y * SCREEN_WIDTH]);
+            y++;
+        }
+        SDL_Rect rect = { 0, first, SCREEN_WIDTH, y - first };
+        SDL_UpdateTexture(screen_texture, &rect, &staging[first * SCREEN_WIDTH],
+                          SCREEN_WIDTH * sizeof(uint32_t));
+    }
+    SDL_RenderCopy(renderer, screen_texture, NULL, NULL);
+    present();
+}
+
+// Поток эмуляции: выполняет кадр за кадром в собственном темпе (60 Гц)
+// и публикует готовые снимки экрана, не дожидаясь отрисовки.
+static int emulation_thread(void *data) {
+    CHIP8 *chip = (CHIP8*)data;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 period = freq / FRAME_RATE;
+    Uint64 next = SDL_GetPerformanceCounter();
+    uint32_t seq = 0;
+    int64_t frame = 0;          // Номер кадра — шкала времени для звука
+    int beeping = 0;
+
+    trace_thread_name("emulation");
+    // Счётчики привязаны к потоку — открываем их здесь
+    if (perf_on && !perf_open(&perf)) perf_on = 0;
+    atomic_store(&emu_started, 1);
+
+    while (atomic_load(&running)) {
+        // Кадр покрывает интервал [next - period, next): инструкция,
+        // начатая на цикле c, соответствует моменту start + period * c / cpt,
+        // и нажатия применяются ровно перед этой инструкцией
+        // Кадр — это cycles_per_tick единиц времени эмуляции: ipf инструкций
+        // или, в режиме VIP, циклов с разной стоимостью инструкций
+        Uint64 start = next - period;
+        uint64_t cpt = chip->cycles_per_tick;
+        uint64_t frame_start = (uint64_t)frame * cpt;
+        uint64_t executed = 0;
+        if (perf_on) perf_begin(&perf);
+        uint64_t t_exec = TRACE_BEGIN();
+        Uint64 exec_start = SDL_GetPerformanceCounter();
+        while (chip->cycles < frame_start + cpt) {
+            Uint64 t = start + period * (chip->cycles - frame_start) / cpt;
+            InputEvent *ev;
+            while ((ev = spsc_peek(&input_queue)) && ev->timestamp <= t) {
+                chip->keys[ev->key] = ev->pressed;
+                spsc_pop(&input_queue);
+            }
+            uint16_t opcode = fetch_opcode(chip);
+            execute(chip, opcode);
+            executed++;
+
+            // Фронты бипера отправляем с точностью до инструкции
+            if ((sound_timer(chip) > 0) != beeping) {
+                beeping = !beeping;
+                if (audio_dev) {
+                    uint64_t pos = chip->cycles - frame_start;
+                    if (pos > cpt) pos = cpt; // Dxyn в режиме VIP ждёт следующего кадра
+                    beeper_push(&beeper, frame * SAMPLES_PER_FRAME +
+                                (int64_t)(pos * SAMPLES_PER_FRAME / cpt), beeping);
+                }
+            }
+        }
+        TRACE_END("execute batch", t_exec);
+        atomic_fetch_add_explicit(&emu_exec_ticks, SDL_GetPerformanceCounter() - exec_start,
+                                  memory_order_relaxed);
+        atomic_fetch_add_explicit(&emu_instructions, executed, memory_order_relaxed);
+        atomic_fetch_add_explicit(&emu_frames, 1, memory_order_relaxed);
+        if (perf_on) perf_end(&perf, executed);
+
+        // Таймеры вычисляются по счётчику инструкций: после последней
+        // инструкции кадра sound_timer() уже учитывает такт на его границе,
+        // так что отдельного обновления и проверки в конце кадра не нужно
+        frame++;
+        atomic_store(&emu_time, frame * SAMPLES_PER_FRAME);
+
+        if (chip->dirty_rows) {
+            uint64_t t = TRACE_BEGIN();
+            FrameSnapshot *snap = tb_back(&frames);
+            memcpy(snap->display, chip->display, sizeof(chip->display));
+            snap->dirty_rows = chip->dirty_rows;
+            snap->seq = ++seq;
+            tb_publish(&frames);
+            chip->dirty_rows = 0;
+            TRACE_END("publish", t);
+        }
+
+        next += period;
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now < next) {
+            uint64_t t = TRACE_BEGIN();
+            SDL_Delay((Uint32)((next - now) * 1000 / freq));
+            TRACE_END("sleep", t);
+        } else if (now - next > period * 4) {
+            next = now; // Сильно отстали — не пытаемся догнать рывком
+        }
+    }
+    return 0;
+}
+
+// Профиль запуска (--startup-profile): начало и конец каждой фазы main().
+// Каждую фазу пишет ровно один поток, читается всё после первого кадра.
+enum {
+    PHASE_SDL_INIT,
+    PHASE_WINDOW,
+    PHASE_RENDERER,
+    PHASE_DB,
+    PHASE_ROM,
+    PHASE_AUDIO,
+    PHASE_FIRST_PRESENT,
+    PHASE_COUNT
+};
+
+static const char *phase_names[PHASE_COUNT] = {
+    "SDL_Init", "window creation", "renderer creation", "DB open/populate",
+    "ROM load", "audio init", "first present"
+};
+
+static int startup_profile = 0;
+static Uint64 profile_start;
+static Uint64 phase_begin[PHASE_COUNT], phase_end[PHASE_COUNT];
+
+static void phase_enter(int phase) {
+    if (startup_profile) phase_begin[phase] = SDL_GetPerformanceCounter();
+}
+
+static void phase_leave(int phase) {
+    if (startup_profile) phase_end[phase] = SDL_GetPerformanceCounter();
+}
+
+static void print_startup_profile(void) {
+    double ms = 1000.0 / SDL_GetPerformanceFrequency();
+    printf("Startup profile (ms):\n");
+    printf("  %-20s %9s %9s\n", "phase", "start", "duration");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        if (!phase_end[i]) continue;    // Фаза не выполнялась
+        printf("  %-20s %9.2f %9.2f\n", phase_names[i],
+               (phase_begin[i] - profile_start) * ms,
+               (phase_end[i] - phase_begin[i]) * ms);
+    }
+    printf("  %-20s %9s %9.2f\n", "time to first frame", "",
+           (phase_end[PHASE_FIRST_PRESENT] - profile_start) * ms);
+}
+
+// Работа с базой при запуске игры. Выполняется в фоновом потоке,
+// параллельно с инициализацией SDL и созданием окна.
+typedef struct StartupDB {
+    CHIP8 *chip;
+    int by_id;          // Запуск по id: база нужна для загрузки ROM
+    int id;
+    int loaded;         // ROM загружен (для запуска по id)
+    int have_config;
+    RomConfig config;
+} StartupDB;
+
+static int startup_db_thread(void *data) {
+    StartupDB *job = (StartupDB*)data;
+    GameDB *db;
+
+    phase_enter(PHASE_DB);
+    if (job->by_id) {
+        db = init_db("chip8_games.db");
+        if (!db) {
+            fprintf(stderr, "Failed to open database.\n");
+            phase_leave(PHASE_DB);
+            return 0;
+        }
+        populate_default_games(db); // заполняем тестовыми играми при первом запуске
+        phase_leave(PHASE_DB);
+        phase_enter(PHASE_ROM);
+        job->loaded = load_game(db, job->id, job->chip);
+        phase_leave(PHASE_ROM);
+    } else {
+        // Запуск по пути: базу не создаём и не заполняем, только ищем
+        // настройки по хэшу, если библиотека уже существует
+        db = open_db_readonly("chip8_games.db");
+        phase_leave(PHASE_DB);
+        if (!db) return 0;
+    }
+    if ((!job->by_id || job->loaded) && db_find_config(db, job->chip->rom_hash, &job->config)) {
+        job->have_config = 1;
+    }
+    close_db(db);
+    return 0;
+}
+
+static void print_search_result(void *ctx, int id, const char *name, const char *author,
+                                int year, double rank) {
+    (void)ctx;
+    (void)rank;
+    printf("%6d  %s", id, name ? name : "");
+    if (author && *author) printf(" - %s", author);
+    if (year) printf(" (%d)", year);
+    printf("\n");
+}
+
+// search <words...>: полнотекстовый поиск по библиотеке
+static int search_main(int argc, char *argv[]) {
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <game_id> or %s <rom_file>\n", argv[0], argv[0]);
+        fprintf(stderr, "Usage: search <words...>\n");
+        return 1;
+    }
+    char query[512] = "";
+    for (int i = 1; i < argc; i++) {
+        if (i > 1) strncat(query, " ", sizeof(query) - strlen(query) - 1);
+        strncat(query, argv[i], sizeof(query) - strlen(query) - 1);
+    }
+    GameDB *db = init_db("chip8_games.db");
+    if (!db) return 1;
+    populate_default_games(db);
+    int found = db_search(db, query, 50, print_search_result, NULL);
+    close_db(db);
+    if (found == 0) printf("Nothing found.\n");
+    return found < 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <game_id> or %s <rom_file> [options]\n", prog, prog);
+    fprintf(stderr, "       %s batch <rom_file...> [--instances N] [--frames N]\n", prog);
+    fprintf(stderr, "       %s tune <game_id|rom_file> [--frames N] [--dry-run]   (pick and store the game speed)\n", prog);
+    fprintf(stderr, "       %s import <dir>   (add all .ch8/.sc8/.xo8 files under dir to the library)\n", prog);
+    fprintf(stderr, "       %s search <words...>\n", prog);
+    fprintf(stderr, "       %s embed   (store ROM files of all library games inside the database)\n", prog);
+    fprintf(stderr, "       %s headless <game_id|rom_file> [--frames N] [--vip] [--perf-counters] [--wav file | --raw file]\n", prog);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --filter nearest|scale2x|scale3x  software upscaling\n");
+    fprintf(stderr, "  --phosphor                        phosphor persistence (anti-flicker)\n");
+    fprintf(stderr, "  --startup-profile                 print a launch time breakdown\n");
+    fprintf(stderr, "  --vip                             COSMAC VIP instruction timing instead of fixed IPS\n");
+    fprintf(stderr, "  --perf-counters                   host CPU counters around each frame (Linux)\n");
+    fprintf(stderr, "  --trace file.json                 record frame phases as a Chrome trace (Perfetto)\n");
+    fprintf(stderr, "F1 toggles the performance overlay.\n");
+}
+
+int main(int argc, char *argv[]) {
+    // Подкоманды, которым не нужны окно и звуковая карта
+    if (argc > 1 && strcmp(argv[1], "headless") == 0) {
+        return headless_main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+        return batch_main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "tune") == 0) {
+        return tune_main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "import") == 0) {
+        return import_main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "search") == 0) {
+        return search_main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "embed") == 0) {
+        GameDB *db = init_db("chip8_games.db");
+        if (!db) return 1;
+        populate_default_games(db);
+        int n = db_embed_roms(db);
+        close_db(db);
+        printf("Embedded %d ROM(s) into the database.\n", n < 0 ? 0 : n);
+        return n < 0;
+    }
+
+    const char *rom_arg = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "nearest") == 0) soft_filter = FILTER_NEAREST;
+            else if (strcmp(name, "scale2x") == 0) soft_filter = FILTER_SCALE2X;
+            else if (strcmp(name, "scale3x") == 0) soft_filter = FILTER_SCALE3X;
+            else {
+                fprintf(stderr, "Unknown filter: %s\n", name);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--phosphor") == 0) {
+            phosphor_on = 1;
+        } else if (strcmp(argv[i], "--startup-profile") == 0) {
+            startup_profile = 1;
+        } else if (strcmp(argv[i], "--vip") == 0) {
+            vip_timing = 1;
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            perf_on = 1;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        } else if (!rom_arg) {
+            rom_arg = argv[i];
+        }
+    }
+    if (!rom_arg) {
+        usage(argv[0]);
         return 1;
     }
 
+    profile_start = SDL_GetPerformanceCounter();
+    if (trace_path) {
+        trace_start();
+        trace_thread_name("main");
+    }
+
+    // Инициализация эмулятора. ROM по пути загружаем сразу — это дёшево
+    // и не требует базы; ошибку увидим до создания окна
+    CHIP8 chip;
+    initialize(&chip);
+    if (vip_timing) set_vip_timing(&chip, 1);
+
+    StartupDB job;
+    memset(&job, 0, sizeof(job));
+    job.chip = &chip;
+    char *endptr;
+    long id = strtol(rom_arg, &endptr, 10);
+    job.by_id = (*endptr == '\0');
+    job.id = (int)id;
+    if (!job.by_id) {
+        phase_enter(PHASE_ROM);
+        int ok = load_rom(&chip, rom_arg);
+        phase_leave(PHASE_ROM);
+        if (!ok) {
+            printf("Failed to load ROM.\n");
+            return 1;
+        }
+    }
+
+    // База открывается в фоне, пока SDL создаёт окно и рендерер
+    SDL_Thread *db_thread = SDL_CreateThread(startup_db_thread, "chip8-db", &job);
+    if (!db_thread) startup_db_thread(&job);
+
     // Инициализация SDL 
+    phase_enter(PHASE_SDL_INIT);
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
         printf("SDL init error: %s\n", SDL_GetError());
         return 1;
     }
+    phase_leave(PHASE_SDL_INIT);
 
     // Создание окна и рендерера 
+    phase_enter(PHASE_WINDOW);
     window = SDL_CreateWindow("CHIP-8 Emulator",
                               SDL_WINDOWPOS_CENTERED,
                               SDL_WINDOWPOS_CENTERED,
@@ -156,43 +724,59 @@ int main(int argc, char *argv[]) {
         printf("SDL window error: %s\n", SDL_GetError());
         return 1;
     }
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    phase_leave(PHASE_WINDOW);
+    // Отрисовка синхронизирована с обновлением дисплея
+    phase_enter(PHASE_RENDERER);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (!renderer) {
+        // Нет GPU — программный рендерер
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    }
     if (!renderer) {
         printf("SDL renderer error: %s\n", SDL_GetError());
         return 1;
     }
+    SDL_RendererInfo info;
+    int have_info = SDL_GetRendererInfo(renderer, &info) == 0;
+    int vsync = have_info && (info.flags & SDL_RENDERER_PRESENTVSYNC);
 
-    // Инициализация эмулятора
-    CHIP8 chip;
-    initialize(&chip);
-
-    // Инициализация базы данных
-    sqlite3 *db = init_db("chip8_games.db");
-    if (!db) {
-        fprintf(stderr, "Failed to open database. Continuing without DB...\n");
-        // Можно продолжить без базы, используя прямой путь
-    } else {
-        populate_default_games(db); // заполняем тестовыми играми при первом запуске
+    // Послесвечение работает с текстурой 64x32, увеличение выполняет SDL
+    if (phosphor_on && soft_filter) {
+        printf("Warning: --phosphor ignores --filter\n");
+        soft_filter = 0;
     }
 
-    // Загрузка ROM
-    int loaded = 0;
-    char *endptr;
-    long id = strtol(argv[1], &endptr, 10);
-
-    if (*endptr == '\0' && db) { // аргумент — число, и БД открыта
-        char *path = get_rom_path(db, (int)id);
-        if (path) {
-            loaded = load_rom(&chip, path);
-            free(path);
-        } else {
-            printf("Game with ID %ld not found in database.\n", id);
+    // Программному рендереру масштабирование обходится дорого — увеличиваем сами
+    if (!phosphor_on && !soft_filter && have_info && (info.flags & SDL_RENDERER_SOFTWARE)) {
+        soft_filter = FILTER_NEAREST;
+    }
+    if (soft_filter) {
+        upscale_size(soft_filter, SCALE, &texture_w, &texture_h);
+        soft_pixels = malloc((size_t)texture_w * texture_h * sizeof(uint32_t));
+        if (!soft_pixels) {
+            printf("Error: out of memory\n");
+            return 1;
         }
-    } else { // аргумент — путь к файлу
-        loaded = load_rom(&chip, argv[1]);
     }
+    screen_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                       SDL_TEXTUREACCESS_STREAMING,
+                                       texture_w, texture_h);
+    if (!screen_texture) {
+        printf("SDL texture error: %s\n", SDL_GetError());
+        return 1;
+    }
+    phase_leave(PHASE_RENDERER);
 
-    close_db(db); // база больше не нужна
+    // Дожидаемся базы: к этому моменту окно уже создано
+    if (db_thread) SDL_WaitThread(db_thread, NULL);
+    int loaded = job.by_id ? job.loaded : 1;
+
+    // Настройки игры ищем по содержимому ROM, а не по имени файла
+    set_keymap(DEFAULT_KEYMAP);
+    if (loaded && job.have_config) {
+        apply_config(&chip, &job.config);
+    }
+    phosphor_init(&phosphor, color_on, color_off);
 
     if (!loaded) {
         printf("Failed to load ROM.\n");
@@ -201,26 +785,121 @@ int main(int argc, char *argv[]) {
     }
 
     // Инициализация звука
-    init_audio(&chip);
+    phase_enter(PHASE_AUDIO);
+    init_audio();
+    phase_leave(PHASE_AUDIO);
+
+    seed_random(&chip, (uint32_t)time(NULL)); // В окне — случайно, без окна — DEFAULT_SEED
 
-    srand(time(NULL));
+    // Эмуляция в отдельном потоке, отрисовка — в главном
+    tb_init(&frames);
+    if (!spsc_init(&input_queue, INPUT_QUEUE_SIZE, sizeof(InputEvent))) {
+        printf("Error: cannot allocate input queue\n");
+        SDL_Quit();
+        return 1;
+    }
+    SDL_Thread *emu = SDL_CreateThread(emulation_thread, "chip8-emu", &chip);
+    if (!emu) {
+        printf("SDL thread error: %s\n", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+
+    uint32_t last_seq = 0;
+    int presented = 0;
+    Uint64 last_present = 0;           // Для гистограммы времени кадра
+    uint64_t phosphor_seen = 0;        // Кадров эмуляции, уже учтённых в затухании
 
-    // Основной цикл эмуляции
-    while (1) {
-        handle_input(&chip);
-        for (int i = 0; i < 10; i++) {
-            uint16_t opcode = fetch_opcode(&chip);
-            execute(&chip, opcode);
+    phase_enter(PHASE_FIRST_PRESENT);
+    while (atomic_load(&running)) {
+        // Опрос ввода записывается, только если кадр выводится: иначе
+        // холостые итерации раз в 1 мс за полминуты вытеснили бы весь буфер
+        uint64_t t_input = TRACE_BEGIN();
+        handle_input();
+        uint64_t t_input_end = TRACE_BEGIN();
+        int fresh;
+        const FrameSnapshot *frame = tb_acquire(&frames, &fresh);
+        uint32_t dirty = 0;
+        if (fresh) {
+            // Если часть снимков пропущена, их маски потеряны — обновляем всё
+            dirty = (frame->seq == last_seq + 1) ? frame->dirty_rows : ALL_ROWS;
+            if (last_seq && frame->seq > last_seq + 1) dropped_frames += frame->seq - last_seq - 1;
+            last_seq = frame->seq;
+        }
+        if (redraw_pending) {
+            redraw_pending = 0;
+            if (!dirty) dirty = ALL_ROWS;
+        }
+        // С оверлеем выводим каждый кадр: иначе время кадра не измерить
+        if (hud_on) update_hud(SDL_GetPerformanceCounter());
+        uint64_t t = TRACE_BEGIN();
+        render_start = SDL_GetPerformanceCounter();
+        int phosphor_steps = 0;
+        if (phosphor_on) {
+            uint64_t done = atomic_load_explicit(&emu_frames, memory_order_relaxed);
+            phosphor_steps = (int)(done - phosphor_seen);
+            phosphor_seen = done;
+        }
+        if (phosphor_on && (dirty || hud_on || (phosphor_steps && phosphor.active_rows))) {
+            draw_phosphor(frame->display, phosphor_steps);
+            TRACE_END("draw_phosphor", t);
+        } else if (dirty || hud_on) {
+            draw_screen(frame->display, dirty);
+            TRACE_END("draw_screen", t);
+        } else {
+            SDL_Delay(1); // Ничего не изменилось — не тратим present (и не трассируем)
+            continue;
+        }
+        if (t_input) trace_span("input poll", t_input, t_input_end);
+        if (hud_on) {
+            Uint64 now = SDL_GetPerformanceCounter();
+            if (last_present) {
+                hist_add(&hud_hist, (uint32_t)((now - last_present) * 1000000 / SDL_GetPerformanceFrequency()));
+            }
+            last_present = now;
+        } else {
+            last_present = 0;
+        }
+        if (!presented) {
+            presented = 1;
+            phase_leave(PHASE_FIRST_PRESENT);
+            if (startup_profile) print_startup_profile();
         }
-        update_timers(&chip);
-        if (chip.draw_flag) {
-            draw_screen(&chip);
+        if (!vsync) {
+            t = TRACE_BEGIN();
+            SDL_Delay(1000 / FRAME_RATE); // Без vsync ограничиваем частоту сами
+            TRACE_END("sleep", t);
         }
-        SDL_Delay(32);
     }
+    SDL_WaitThread(emu, NULL);
+
+    if (audio_dev) {
+        printf("Audio: fill %d samples (target %d), rate skew %d ppm, %u resyncs\n",
+               atomic_load(&beeper.fill), AUDIO_LATENCY,
+               atomic_load(&beeper.skew_ppm), atomic_load(&beeper.resyncs));
+    }
+    if (phosphor_frames) {
+        double us = 1e6 / SDL_GetPerformanceFrequency();
+        printf("Phosphor: %.2f us/frame avg, %.2f us max over %llu frames\n",
+               phosphor_ticks * us / phosphor_frames, phosphor_max * us,
+               (unsigned long long)phosphor_frames);
+    }
+    if (perf_on) {
+        perf_report(&perf);
+        perf_close(&perf);
+    }
+    STATS_DUMP(&chip);
+    spsc_free(&input_queue);
 
     // Завершение
-    if (audio_dev != 0) SDL_CloseAudioDevice(audio_dev);
+    if (audio_dev != 0) {
+        SDL_CloseAudioDevice(audio_dev);
+        beeper_free(&beeper);
+    }
+    if (trace_path) trace_dump(trace_path);  // Все потоки уже остановлены
+    SDL_DestroyTexture(screen_texture);
+    if (hud_texture) SDL_DestroyTexture(hud_texture);
+    free(soft_pixels);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
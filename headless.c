@@ -0,0 +1,300 @@
+#include "headless.h"
+#include "db.h"
+#include "romcache.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_FRAMES 600
+
+int run_init(HeadlessRun *run, int ipf, int audio) {
+    initialize(&run->chip);
+    run->chip.cycles_per_tick = ipf;
+    run->ipf = ipf;
+    run->frame = 0;
+    run->instructions = 0;
+    run->perf = NULL;
+    run->beeping = 0;
+    run->audio = audio;
+    if (audio && !beeper_init(&run->beeper, SAMPLE_RATE, TONE_FREQUENCY, AMPLITUDE)) {
+        return 0;
+    }
+    return 1;
+}
+
+void run_free(HeadlessRun *run) {
+    if (run->audio) beeper_free(&run->beeper);
+}
+
+static void push_edge(HeadlessRun *run, int64_t time) {
+    run->beeping = !run->beeping;
+    if (run->audio) beeper_push(&run->beeper, time, run->beeping);
+}
+
+// Один кадр эмуляции; если pcm не NULL, туда синтезируется
+// SAMPLES_PER_FRAME сэмплов звука этого кадра
+void run_frame(HeadlessRun *run, int16_t *pcm) {
+    CHIP8 *chip = &run->chip;
+    int64_t base = run->frame * SAMPLES_PER_FRAME;
+    uint64_t cpt = chip->cycles_per_tick;
+    uint64_t frame_start = (uint64_t)run->frame * cpt;
+    uint64_t executed = run->instructions;
+    if (run->perf) perf_begin(run->perf);
+
+    // Кадр — это cycles_per_tick единиц времени: ipf инструкций или,
+    // в режиме VIP, циклов, которые инструкции тратят по-разному
+    while (chip->cycles < frame_start + cpt) {
+        uint16_t opcode = fetch_opcode(chip);
+        execute(chip, opcode);
+        run->instructions++;
+        if ((sound_timer(chip) > 0) != run->beeping) {
+            uint64_t pos = chip->cycles - frame_start;
+            if (pos > cpt) pos = cpt;
+            push_edge(run, base + (int64_t)(pos * SAMPLES_PER_FRAME / cpt));
+        }
+    }
+    if (run->perf) perf_end(run->perf, run->instructions - executed);
+    run->frame++;
+    chip->dirty_rows = 0;
+
+    if (pcm && run->audio) beeper_render(&run->beeper, pcm, SAMPLES_PER_FRAME);
+}
+
+// Настройки игры из базы — так же, как apply_config() в окне:
+// скорость (если не включены тайминги VIP) и особенности интерпретатора
+static void apply_run_config(HeadlessRun *run, const RomConfig *cfg) {
+    if (cfg->ips > 0 && !run->chip.vip_timing) {
+        run->ipf = cfg->ips / FRAME_RATE;
+        if (run->ipf < 1) run->ipf = 1;
+        run->chip.cycles_per_tick = run->ipf;
+    }
+    run->chip.quirks = (uint8_t)cfg->quirks;
+}
+
+// FNV-1a, 64 бита — для сверки результатов прогона
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+static void put_u16(FILE *f, uint16_t v) {
+    fputc(v & 0xFF, f);
+    fputc(v >> 8, f);
+}
+
+static void put_u32(FILE *f, uint32_t v) {
+    put_u16(f, v & 0xFFFF);
+    put_u16(f, v >> 16);
+}
+
+// Заголовок WAV (PCM, 16 бит, моно); размеры дописываются в finish_wav()
+static void write_wav_header(FILE *f, uint32_t data_bytes) {
+    fwrite("RIFF", 1, 4, f);
+    put_u32(f, 36 + data_bytes);
+    fwrite("WAVEfmt ", 1, 8, f);
+    put_u32(f, 16);
+    put_u16(f, 1);                      // PCM
+    put_u16(f, 1);                      // Моно
+    put_u32(f, SAMPLE_RATE);
+    put_u32(f, SAMPLE_RATE * 2);        // Байт в секунду
+    put_u16(f, 2);                      // Байт на сэмпл
+    put_u16(f, 16);                     // Бит на сэмпл
+    fwrite("data", 1, 4, f);
+    put_u32(f, data_bytes);
+}
+
+// headless <rom_file|game_id> [--frames N] [--vip] [--perf-counters] [--wav file | --raw file]
+int headless_main(int argc, char *argv[]) {
+    const char *rom_arg = NULL, *wav_path = NULL, *raw_path = NULL;
+    long frames = DEFAULT_FRAMES;
+    int vip = 0, perf_on = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--wav") == 0 && i + 1 < argc) {
+            wav_path = argv[++i];
+        } else if (strcmp(argv[i], "--raw") == 0 && i + 1 < argc) {
+            raw_path = argv[++i];
+        } else if (strcmp(argv[i], "--vip") == 0) {
+            vip = 1;
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            perf_on = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        } else if (!rom_arg) {
+            rom_arg = argv[i];
+        }
+    }
+    if (!rom_arg || frames <= 0) {
+        fprintf(stderr, "Usage: headless <rom_file|game_id> [--frames N] [--vip] [--perf-counters] [--wav file | --raw file]\n");
+        return 1;
+    }
+
+    HeadlessRun run;
+    if (!run_init(&run, INSTRUCTIONS_PER_FRAME, 1)) {
+        printf("Error: cannot allocate audio queue\n");
+        return 1;
+    }
+    if (vip) set_vip_timing(&run.chip, 1);
+
+    // Настройки игры ищем по хэшу ROM при любом способе загрузки, как и
+    // окно: по id — в той же базе, по пути — открыв её только для чтения
+    int loaded = 0;
+    char *endptr;
+    long id = strtol(rom_arg, &endptr, 10);
+    GameDB *db;
+    if (*endptr == '\0') {
+        db = init_db("chip8_games.db");
+        if (db) loaded = load_game(db, (int)id, &run.chip);
+    } else {
+        loaded = load_rom(&run.chip, rom_arg);
+        db = loaded ? open_db_readonly("chip8_games.db") : NULL;
+    }
+    RomConfig cfg;
+    if (loaded && db && db_find_config(db, run.chip.rom_hash, &cfg)) {
+        apply_run_config(&run, &cfg);
+    }
+    close_db(db);
+    if (!loaded) {
+        printf("Failed to load ROM.\n");
+        run_free(&run);
+        return 1;
+    }
+
+    FILE *out = NULL;
+    const char *out_path = wav_path ? wav_path : raw_path;
+    if (out_path) {
+        out = fopen(out_path, "wb");
+        if (!out) {
+            printf("Error: Cannot open file %s\n", out_path);
+            run_free(&run);
+            return 1;
+        }
+        if (wav_path) write_wav_header(out, 0);
+    }
+
+    PerfCounters perf;
+    if (perf_on && perf_open(&perf)) run.perf = &perf;
+
+    // Синтез блоками по кадру: быстрее реального времени в тысячи раз
+    int16_t pcm[SAMPLES_PER_FRAME];
+    uint64_t audio_hash = 0xCBF29CE484222325ULL;
+    uint32_t audio_bytes = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (long f = 0; f < frames; f++) {
+        run_frame(&run, pcm);
+        audio_hash = fnv1a(audio_hash, pcm, sizeof(pcm));
+        if (out) fwrite(pcm, sizeof(int16_t), SAMPLES_PER_FRAME, out);
+        audio_bytes += sizeof(pcm);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (out) {
+        if (wav_path) {
+            rewind(out);
+            write_wav_header(out, audio_bytes);
+        }
+        fclose(out);
+    }
+
+    uint64_t display_hash = fnv1a(0xCBF29CE484222325ULL, run.chip.display, sizeof(run.chip.display));
+    printf("frames: %ld\n", frames);
+    printf("rom hash: %016llx\n", (unsigned long long)run.chip.rom_hash);
+    printf("display hash: %016llx\n", (unsigned long long)display_hash);
+    printf("audio hash: %016llx (%u samples)\n", (unsigned long long)audio_hash,
+           audio_bytes / (unsigned)sizeof(int16_t));
+
+    // Скорость в эмулируемом времени (кадр = 1/60 с) и на хосте
+    double emu_sec = (double)frames / FRAME_RATE;
+    double host_sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("emulated: %.0f instructions/s", run.instructions / emu_sec);
+    if (vip) printf(" (%.0f VIP cycles/s)", run.chip.cycles / emu_sec);
+    printf("\n");
+    if (host_sec > 0) {
+        printf("host: %.0f instructions/s, %.0fx real time\n",
+               run.instructions / host_sec, emu_sec / host_sec);
+    }
+    if (run.perf) {
+        perf_report(run.perf);
+        perf_close(run.perf);
+    }
+    STATS_DUMP(&run.chip);
+
+    run_free(&run);
+    return 0;
+}
+
+
+// batch <rom_file...> [--instances N] [--frames N]
+// Пакетный прогон: каждый ROM запускается в N экземплярах. Файл каждого
+// ROM отображается и хэшируется один раз, экземпляры делят этот образ.
+int batch_main(int argc, char *argv[]) {
+    long frames = DEFAULT_FRAMES, instances = 1;
+    int rom_count = 0;
+    const char **roms = calloc(argc, sizeof(char*));
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instances = strtol(argv[++i], NULL, 10);
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            free(roms);
+            return 1;
+        } else {
+            roms[rom_count++] = argv[i];
+        }
+    }
+    if (rom_count == 0 || frames <= 0 || instances <= 0) {
+        fprintf(stderr, "Usage: batch <rom_file...> [--instances N] [--frames N]\n");
+        free(roms);
+        return 1;
+    }
+
+    int failed = 0;
+    int16_t pcm[SAMPLES_PER_FRAME];
+    for (int r = 0; r < rom_count; r++) {
+        RomImage *image = rom_image_open(roms[r]);
+        if (!image) {
+            failed++;
+            continue;
+        }
+        for (long n = 0; n < instances; n++) {
+            HeadlessRun run;
+            if (!run_init(&run, INSTRUCTIONS_PER_FRAME, 1)) {
+                printf("Error: cannot allocate audio queue\n");
+                failed++;
+                break;
+            }
+            load_rom_image(&run.chip, image);
+
+            uint64_t audio_hash = 0xCBF29CE484222325ULL;
+            for (long f = 0; f < frames; f++) {
+                run_frame(&run, pcm);
+                audio_hash = fnv1a(audio_hash, pcm, sizeof(pcm));
+            }
+            uint64_t display_hash = fnv1a(0xCBF29CE484222325ULL, run.chip.display,
+                                          sizeof(run.chip.display));
+            printf("%s #%ld: rom %016llx display %016llx audio %016llx\n", roms[r], n,
+                   (unsigned long long)image->hash, (unsigned long long)display_hash,
+                   (unsigned long long)audio_hash);
+            run_free(&run);
+        }
+        // Образ остаётся в кэше до конца прогона: тот же файл дальше в списке
+        // не будет отображён повторно
+    }
+    printf("%d ROM image(s) mapped for %d argument(s) x %ld instance(s)\n",
+           rom_cache_count(), rom_count, instances);
+
+    free(roms);
+    return failed != 0;
+}
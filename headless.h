@@ -0,0 +1,30 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "chip8.h"
+#include "beeper.h"
+#include "perfcount.h"
+
+// Прогон эмулятора без окна и звуковой карты: кадр за кадром,
+// с офлайн-синтезом звука блоками по SAMPLES_PER_FRAME сэмплов
+typedef struct HeadlessRun {
+    CHIP8 chip;
+    Beeper beeper;
+    int ipf;                // Инструкций за кадр
+    int64_t frame;          // Номер кадра
+    uint64_t instructions;  // Выполнено инструкций
+    int beeping;            // Состояние бипера
+    int audio;              // Синтезировать ли звук
+    PerfCounters *perf;     // Аппаратные счётчики вокруг execute() или NULL
+} HeadlessRun;
+
+int run_init(HeadlessRun *run, int ipf, int audio);
+void run_free(HeadlessRun *run);
+void run_frame(HeadlessRun *run, int16_t *pcm);
+
+int headless_main(int argc, char *argv[]);
+int batch_main(int argc, char *argv[]);
+
+#endif
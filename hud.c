@@ -0,0 +1,94 @@
+#include "hud.h"
+#include "fontset.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HUD_BACKGROUND 0xB0000000u   // Полупрозрачный чёрный
+#define HUD_TEXT 0xFFFFFFFFu
+#define HUD_BAR 0xFF40E040u
+#define LINE_HEIGHT 6                // Символ 4x5 и интервал
+#define CHAR_WIDTH 5
+#define GRAPH_TOP 37
+
+void hist_add(FrameHistogram *h, uint32_t us) {
+    uint32_t bucket = us / HIST_BUCKET_US;
+    if (bucket >= HIST_BUCKETS) bucket = HIST_BUCKETS - 1;
+    h->count[bucket]++;
+    h->total++;
+}
+
+// Верхняя граница корзины, в которую попадает percent% кадров
+uint32_t hist_percentile(const FrameHistogram *h, int percent) {
+    if (!h->total) return 0;
+    uint64_t need = ((uint64_t)h->total * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->count[b];
+        if (seen >= need) return (b + 1) * HIST_BUCKET_US;
+    }
+    return HIST_BUCKETS * HIST_BUCKET_US;
+}
+
+void hist_reset(FrameHistogram *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+// Строка из 0-9, A-F и пробелов глифами fontset (старшая тетрада байта)
+static void draw_text(uint32_t *pixels, int pitch, int x, int y, const char *text) {
+    for (; *text && x + 4 <= HUD_WIDTH; text++, x += CHAR_WIDTH) {
+        int glyph;
+        if (*text >= '0' && *text <= '9') glyph = *text - '0';
+        else if (*text >= 'A' && *text <= 'F') glyph = *text - 'A' + 10;
+        else continue;
+        for (int row = 0; row < 5; row++) {
+            uint8_t bits = fontset[glyph * 5 + row];
+            for (int col = 0; col < 4; col++) {
+                if (bits & (0x80 >> col)) pixels[(y + row) * pitch + x + col] = HUD_TEXT;
+            }
+        }
+    }
+}
+
+// Перерисовывает весь оверлей; pitch — в пикселях
+void hud_render(uint32_t *pixels, int pitch, const HudStats *s, const FrameHistogram *h) {
+    for (int y = 0; y < HUD_HEIGHT; y++) {
+        for (int x = 0; x < HUD_WIDTH; x++) pixels[y * pitch + x] = HUD_BACKGROUND;
+    }
+
+    char line[24];
+    int y = 1;
+    snprintf(line, sizeof(line), "C %u", s->ips);
+    draw_text(pixels, pitch, 1, y, line);
+    y += LINE_HEIGHT;
+    snprintf(line, sizeof(line), "F %u %u", s->frame_p50, s->frame_p99);
+    draw_text(pixels, pitch, 1, y, line);
+    y += LINE_HEIGHT;
+    snprintf(line, sizeof(line), "E %u", s->exec_us);
+    draw_text(pixels, pitch, 1, y, line);
+    y += LINE_HEIGHT;
+    snprintf(line, sizeof(line), "B %u", s->render_us);
+    draw_text(pixels, pitch, 1, y, line);
+    y += LINE_HEIGHT;
+    snprintf(line, sizeof(line), "A %d", s->audio_fill < 0 ? 0 : s->audio_fill);
+    draw_text(pixels, pitch, 1, y, line);
+    y += LINE_HEIGHT;
+    snprintf(line, sizeof(line), "D %u", s->dropped);
+    draw_text(pixels, pitch, 1, y, line);
+
+    // Гистограмма: высота столбца пропорциональна доле кадров
+    // (с полной высотой от 25%), чтобы редкие выбросы были видны
+    int columns = HIST_BUCKETS * HIST_BUCKET_US / HUD_COLUMN_US;
+    int per_column = HUD_COLUMN_US / HIST_BUCKET_US;
+    int graph_h = HUD_HEIGHT - GRAPH_TOP - 1;
+    for (int c = 0; c < columns && 4 + c < HUD_WIDTH; c++) {
+        uint32_t n = 0;
+        for (int b = c * per_column; b < (c + 1) * per_column; b++) n += h->count[b];
+        if (!n) continue;
+        int bar = h->total ? (int)((uint64_t)n * 4 * graph_h / h->total) : 0;
+        if (bar < 1) bar = 1;
+        if (bar > graph_h) bar = graph_h;
+        for (int i = 0; i < bar; i++) {
+            pixels[(HUD_HEIGHT - 2 - i) * pitch + 4 + c] = HUD_BAR;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <stdint.h>
+
+// Оверлей производительности (F1). Здесь только подсчёт и растеризация в
+// ARGB-буфер шрифтом fontset; текстура и вывод — в game.c.
+// Шрифт знает лишь 0-9 и A-F, поэтому строки подписаны буквами:
+//   C — эмулируемых инструкций в секунду
+//   F — время кадра хоста p50 и p99, мкс
+//   E — время execute() на кадр эмуляции, мкс
+//   B — время отрисовки кадра (развёртка и загрузка текстуры), мкс
+//   A — заполнение звукового буфера, сэмплов
+//   D — пропущенных кадров эмуляции
+// Внизу — гистограмма времени кадра, столбец на HUD_COLUMN_US мкс.
+
+#define HUD_WIDTH 72
+#define HUD_HEIGHT 48
+#define HIST_BUCKETS 512        // Корзины гистограммы по HIST_BUCKET_US
+#define HIST_BUCKET_US 100      // До 51 мс; всё длиннее — в последнюю
+#define HUD_COLUMN_US 800       // 64 столбца по 8 корзин
+
+typedef struct FrameHistogram {
+    uint32_t count[HIST_BUCKETS];
+    uint32_t total;
+} FrameHistogram;
+
+typedef struct HudStats {
+    uint32_t ips;
+    uint32_t frame_p50, frame_p99;
+    uint32_t exec_us, render_us;
+    int32_t audio_fill;
+    uint32_t dropped;
+} HudStats;
+
+void hist_add(FrameHistogram *h, uint32_t us);
+uint32_t hist_percentile(const FrameHistogram *h, int percent);
+void hist_reset(FrameHistogram *h);
+void hud_render(uint32_t *pixels, int pitch, const HudStats *s, const FrameHistogram *h);
+
+#endif
@@ -0,0 +1,257 @@
+#include "import.h"
+#include "hash.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_WORKERS 16
+#define BATCH_SIZE 2000           // Вставок в одной транзакции
+#define MAX_ROM_SIZE (MEMORY_SIZE - ROM_START)
+
+// Найденный и прохэшированный ROM, ждущий записи в базу
+typedef struct ImportItem {
+    struct ImportItem *next;
+    char *path;
+    uint64_t hash;
+    int size;
+    uint8_t data[];
+} ImportItem;
+
+// Очередь каталогов для обхода и очередь результатов для писателя
+typedef struct Importer {
+    pthread_mutex_t lock;
+    pthread_cond_t dirs_cond;     // Появился каталог или обход закончен
+    pthread_cond_t items_cond;    // Появился результат или рабочие закончили
+    char **dirs;
+    int dir_count, dir_cap;
+    int busy;                     // Рабочих, обходящих каталог прямо сейчас
+    int workers_left;             // Рабочих, ещё не завершившихся
+    ImportItem *items_head, *items_tail;
+    int scanned, skipped_large;
+} Importer;
+
+static void push_dir(Importer *im, char *path) {
+    if (im->dir_count == im->dir_cap) {
+        im->dir_cap = im->dir_cap ? im->dir_cap * 2 : 64;
+        im->dirs = realloc(im->dirs, im->dir_cap * sizeof(char*));
+    }
+    im->dirs[im->dir_count++] = path;
+    pthread_cond_signal(&im->dirs_cond);
+}
+
+static int is_rom_name(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".ch8") == 0 || strcasecmp(dot, ".sc8") == 0 ||
+                   strcasecmp(dot, ".xo8") == 0);
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char *path = malloc(len);
+    if (path) snprintf(path, len, "%s/%s", dir, name);
+    return path;
+}
+
+// Отображает файл в память, проверяет размер и считает хэш
+static ImportItem *hash_file(Importer *im, char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size > MAX_ROM_SIZE) {
+        close(fd);
+        __atomic_fetch_add(&im->skipped_large, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    ImportItem *item = malloc(sizeof(ImportItem) + st.st_size);
+    if (!item) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    item->next = NULL;
+    item->path = path;
+    item->size = (int)st.st_size;
+    item->hash = xxh64(map, st.st_size, 0);
+    memcpy(item->data, map, st.st_size);
+    munmap(map, st.st_size);
+    return item;
+}
+
+// Рабочий поток: берёт каталог, кладёт подкаталоги обратно в очередь,
+// ROM-файлы хэширует и отдаёт писателю
+static void *import_worker(void *arg) {
+    Importer *im = arg;
+    pthread_mutex_lock(&im->lock);
+    for (;;) {
+        while (im->dir_count == 0 && im->busy > 0) {
+            pthread_cond_wait(&im->dirs_cond, &im->lock);
+        }
+        if (im->dir_count == 0) break;      // Очередь пуста и никто её не пополнит
+        char *dir = im->dirs[--im->dir_count];
+        im->busy++;
+        pthread_mutex_unlock(&im->lock);
+
+        DIR *d = opendir(dir);
+        struct dirent *e;
+        while (d && (e = readdir(d))) {
+            if (e->d_name[0] == '.') continue;
+            char *path = join_path(dir, e->d_name);
+            if (!path) continue;
+            // Ссылки на каталоги не обходим: ссылка на предка зациклила бы
+            // обход. Ссылки на файлы ROM открываются как обычно
+            int is_dir = e->d_type == DT_DIR;
+            if (e->d_type == DT_UNKNOWN) {
+                struct stat st;
+                is_dir = lstat(path, &st) == 0 && S_ISDIR(st.st_mode);
+            }
+            if (is_dir) {
+                pthread_mutex_lock(&im->lock);
+                push_dir(im, path);
+                pthread_mutex_unlock(&im->lock);
+                continue;
+            }
+            ImportItem *item = is_rom_name(e->d_name) ? hash_file(im, path) : NULL;
+            if (!item) {
+                free(path);
+                continue;
+            }
+            pthread_mutex_lock(&im->lock);
+            im->scanned++;
+            if (im->items_tail) im->items_tail->next = item;
+            else im->items_head = item;
+            im->items_tail = item;
+            pthread_cond_signal(&im->items_cond);
+            pthread_mutex_unlock(&im->lock);
+        }
+        if (d) closedir(d);
+        free(dir);
+
+        pthread_mutex_lock(&im->lock);
+        im->busy--;
+        if (im->busy == 0 && im->dir_count == 0) pthread_cond_broadcast(&im->dirs_cond);
+    }
+    im->workers_left--;
+    pthread_cond_signal(&im->items_cond);
+    pthread_mutex_unlock(&im->lock);
+    return NULL;
+}
+
+static char *rom_title(const char *path) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t len = strlen(base);
+    const char *dot = strrchr(base, '.');
+    if (dot) len = dot - base;
+    char *title = malloc(len + 1);
+    if (!title) return NULL;
+    memcpy(title, base, len);
+    title[len] = '\0';
+    return title;
+}
+
+// Параллельный импорт каталога: обход и хэширование на пуле потоков,
+// запись — в вызывающем потоке (единственный писатель SQLite) большими
+// транзакциями. Уже известные по хэшу ROM пропускаются.
+// Возвращает число добавленных игр или -1.
+int import_library(GameDB *gdb, const char *root) {
+    // Недоступный корень — ошибка, а не пустой импорт
+    DIR *top = opendir(root);
+    if (!top) {
+        fprintf(stderr, "Cannot open %s: %s\n", root, strerror(errno));
+        return -1;
+    }
+    closedir(top);
+
+    Importer im;
+    memset(&im, 0, sizeof(im));
+    pthread_mutex_init(&im.lock, NULL);
+    pthread_cond_init(&im.dirs_cond, NULL);
+    pthread_cond_init(&im.items_cond, NULL);
+    push_dir(&im, strdup(root));
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int nworkers = (cpus < 1) ? 1 : (cpus > MAX_WORKERS ? MAX_WORKERS : (int)cpus);
+    pthread_t workers[MAX_WORKERS];
+    im.workers_left = nworkers;
+    for (int i = 0; i < nworkers; i++) {
+        pthread_create(&workers[i], NULL, import_worker, &im);
+    }
+
+    int added = 0, duplicates = 0, in_batch = 0;
+    db_begin(gdb);
+    pthread_mutex_lock(&im.lock);
+    for (;;) {
+        while (!im.items_head && im.workers_left > 0) {
+            pthread_cond_wait(&im.items_cond, &im.lock);
+        }
+        ImportItem *batch = im.items_head;
+        im.items_head = im.items_tail = NULL;
+        if (!batch && im.workers_left == 0) break;
+        pthread_mutex_unlock(&im.lock);
+
+        while (batch) {
+            ImportItem *item = batch;
+            batch = batch->next;
+            if (db_has_rom(gdb, item->hash)) {
+                duplicates++;
+            } else {
+                char *title = rom_title(item->path);
+                if (title && add_game(gdb, title, item->path, NULL, 0, NULL) == 0) {
+                    int id = (int)sqlite3_last_insert_rowid(gdb->db);
+                    db_store_rom(gdb, id, item->data, item->size, item->hash);
+                    added++;
+                }
+                free(title);
+            }
+            free(item->path);
+            free(item);
+            if (++in_batch == BATCH_SIZE) {
+                db_commit(gdb);
+                db_begin(gdb);
+                in_batch = 0;
+            }
+        }
+        pthread_mutex_lock(&im.lock);
+    }
+    pthread_mutex_unlock(&im.lock);
+    db_commit(gdb);
+    for (int i = 0; i < nworkers; i++) pthread_join(workers[i], NULL);
+
+    printf("Scanned %d ROM(s) with %d thread(s): %d added, %d already present, %d too large\n",
+           im.scanned, nworkers, added, duplicates, im.skipped_large);
+
+    free(im.dirs);
+    pthread_cond_destroy(&im.items_cond);
+    pthread_cond_destroy(&im.dirs_cond);
+    pthread_mutex_destroy(&im.lock);
+    return added;
+}
+
+// import <dir>
+int import_main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: import <dir>\n");
+        return 1;
+    }
+    GameDB *db = init_db("chip8_games.db");
+    if (!db) return 1;
+    populate_default_games(db);
+    int added = import_library(db, argv[1]);
+    close_db(db);
+    return added < 0;
+}
@@ -0,0 +1,9 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include "db.h"
+
+int import_library(GameDB *gdb, const char *root);
+int import_main(int argc, char *argv[]);
+
+#endif
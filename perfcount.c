@@ -0,0 +1,97 @@
+#include "perfcount.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;    // Хватает perf_event_paranoid <= 2
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t read_counter(int fd) {
+    uint64_t value = 0;
+    if (fd >= 0 && read(fd, &value, sizeof(value)) != sizeof(value)) value = 0;
+    return value;
+}
+#endif
+
+// Открывает счётчики для текущего потока. Недоступные (нет PMU в
+// виртуальной машине, запрет perf_event_paranoid) пропускаются;
+// возвращает 1, если удалось открыть хотя бы такты и инструкции.
+int perf_open(PerfCounters *pc) {
+    memset(pc, 0, sizeof(*pc));
+    for (int i = 0; i < PERF_COUNTERS; i++) pc->fd[i] = -1;
+#ifdef __linux__
+    pc->fd[PERF_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    pc->fd[PERF_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    pc->fd[PERF_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    pc->fd[PERF_L1D_MISSES] = open_counter(PERF_TYPE_HW_CACHE,
+                                           PERF_COUNT_HW_CACHE_L1D |
+                                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    if (pc->fd[PERF_CYCLES] < 0 || pc->fd[PERF_INSTRUCTIONS] < 0) {
+        perror("perf_event_open");
+        perf_close(pc);
+        return 0;
+    }
+    return 1;
+#else
+    fprintf(stderr, "Hardware counters are only supported on Linux\n");
+    return 0;
+#endif
+}
+
+void perf_begin(PerfCounters *pc) {
+#ifdef __linux__
+    for (int i = 0; i < PERF_COUNTERS; i++) pc->start[i] = read_counter(pc->fd[i]);
+#else
+    (void)pc;
+#endif
+}
+
+void perf_end(PerfCounters *pc, uint64_t emulated) {
+#ifdef __linux__
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        if (pc->fd[i] >= 0) pc->total[i] += read_counter(pc->fd[i]) - pc->start[i];
+    }
+#endif
+    pc->frames++;
+    pc->emulated += emulated;
+}
+
+void perf_report(const PerfCounters *pc) {
+    if (!pc->frames || !pc->emulated || pc->fd[PERF_CYCLES] < 0) return;
+    double n = (double)pc->emulated;
+    printf("Perf: %llu frames, %llu emulated instructions\n",
+           (unsigned long long)pc->frames, (unsigned long long)pc->emulated);
+    printf("  host IPC %.2f, %.1f cycles and %.1f instructions per emulated instruction\n",
+           pc->total[PERF_CYCLES] ? (double)pc->total[PERF_INSTRUCTIONS] / pc->total[PERF_CYCLES] : 0,
+           pc->total[PERF_CYCLES] / n, pc->total[PERF_INSTRUCTIONS] / n);
+    if (pc->fd[PERF_BRANCH_MISSES] >= 0) {
+        printf("  %.3f branch mispredicts per emulated instruction\n", pc->total[PERF_BRANCH_MISSES] / n);
+    }
+    if (pc->fd[PERF_L1D_MISSES] >= 0) {
+        printf("  %.3f L1d read misses per emulated instruction\n", pc->total[PERF_L1D_MISSES] / n);
+    }
+}
+
+void perf_close(PerfCounters *pc) {
+#ifdef __linux__
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        if (pc->fd[i] >= 0) close(pc->fd[i]);
+        pc->fd[i] = -1;
+    }
+#else
+    (void)pc;
+#endif
+}
@@ -0,0 +1,31 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdint.h>
+
+// Аппаратные счётчики хоста вокруг пакета execute() каждого кадра
+// (Linux perf_event_open). Счётчики привязаны к потоку, поэтому
+// perf_open() вызывается в том потоке, который выполняет эмуляцию.
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_COUNTERS
+};
+
+typedef struct PerfCounters {
+    int fd[PERF_COUNTERS];          // -1, если счётчик недоступен
+    uint64_t start[PERF_COUNTERS];  // Значения в начале кадра
+    uint64_t total[PERF_COUNTERS];  // Сумма по всем кадрам
+    uint64_t frames;
+    uint64_t emulated;              // Инструкций CHIP-8 за эти кадры
+} PerfCounters;
+
+int perf_open(PerfCounters *pc);
+void perf_begin(PerfCounters *pc);
+void perf_end(PerfCounters *pc, uint64_t emulated);
+void perf_report(const PerfCounters *pc);
+void perf_close(PerfCounters *pc);
+
+#endif
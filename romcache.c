@@ -0,0 +1,79 @@
+#include "romcache.h"
+#include "hash.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Список открытых образов. Кэш рассчитан на один поток (пакетный прогон).
+static RomImage *cache = NULL;
+
+// Отображает ROM (или возвращает уже отображённый) и проверяет размер.
+// Возвращает NULL при ошибке.
+RomImage *rom_image_open(const char *filename) {
+    char resolved[PATH_MAX];
+    const char *key = realpath(filename, resolved) ? resolved : filename;
+
+    for (RomImage *img = cache; img; img = img->next) {
+        if (strcmp(img->path, key) == 0) return img;
+    }
+
+    int fd = open(key, O_RDONLY);
+    if (fd < 0) {
+        printf("Error: Cannot open file %s\n", filename);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        printf("Error: %s is not a ROM file\n", filename);
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size > MEMORY_SIZE - ROM_START) {
+        printf("Error: ROM too large\n");
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // Отображение остаётся действительным и после close()
+    if (map == MAP_FAILED) {
+        printf("Error: Cannot map file %s\n", filename);
+        return NULL;
+    }
+
+    RomImage *img = malloc(sizeof(RomImage));
+    char *path = strdup(key);
+    if (!img || !path) {
+        printf("Error: out of memory\n");
+        munmap(map, st.st_size);
+        free(img);
+        free(path);
+        return NULL;
+    }
+    img->path = path;
+    img->data = map;
+    img->size = (size_t)st.st_size;
+    img->hash = xxh64(map, img->size, 0);
+    img->next = cache;
+    cache = img;
+    return img;
+}
+
+int rom_cache_count(void) {
+    int n = 0;
+    for (RomImage *img = cache; img; img = img->next) n++;
+    return n;
+}
+
+// Копирует общий образ в память экземпляра. Адресное пространство CHIP-8 —
+// ровно одна страница 4 КБ, и игра может писать в любое её место, поэтому
+// каждому экземпляру всё равно нужна своя копия; общими остаются
+// страницы отображения (и кэша ФС) и хэширование файла.
+void load_rom_image(CHIP8 *chip, const RomImage *image) {
+    memcpy(&chip->memory[ROM_START], image->data, image->size);
+    chip->rom_hash = image->hash;
+}
@@ -0,0 +1,23 @@
+#ifndef ROMCACHE_H
+#define ROMCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "chip8.h"
+
+// Образ ROM, отображённый в память только для чтения (MAP_PRIVATE).
+// Каждый файл отображается и хэшируется один раз, все экземпляры
+// эмулятора с этим ROM копируют его отсюда. Образы живут до конца процесса.
+typedef struct RomImage {
+    struct RomImage *next;
+    char *path;             // Канонический путь — ключ кэша
+    const uint8_t *data;
+    size_t size;
+    uint64_t hash;          // xxHash64, считается один раз при отображении
+} RomImage;
+
+RomImage *rom_image_open(const char *filename);
+int rom_cache_count(void);
+void load_rom_image(CHIP8 *chip, const RomImage *image);
+
+#endif
@@ -0,0 +1,48 @@
+#include "spsc.h"
+#include <stdlib.h>
+#include <string.h>
+
+int spsc_init(SpscRing *ring, unsigned capacity, size_t elem_size) {
+    if (capacity == 0 || (capacity & (capacity - 1))) return 0; // Только степень двойки
+    ring->buf = calloc(capacity, elem_size);
+    if (!ring->buf) return 0;
+    ring->mask = capacity - 1;
+    ring->elem_size = elem_size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return 1;
+}
+
+void spsc_free(SpscRing *ring) {
+    free(ring->buf);
+    ring->buf = NULL;
+}
+
+// Возвращает 0, если буфер полон (элемент не добавлен)
+int spsc_push(SpscRing *ring, const void *elem) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail > ring->mask) return 0;
+    memcpy(ring->buf + (size_t)(head & ring->mask) * ring->elem_size, elem, ring->elem_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+// Указатель на самый старый элемент или NULL, если буфер пуст.
+// Элемент остаётся в буфере до spsc_pop().
+void *spsc_peek(SpscRing *ring) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) return NULL;
+    return ring->buf + (size_t)(tail & ring->mask) * ring->elem_size;
+}
+
+void spsc_pop(SpscRing *ring) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+unsigned spsc_count(SpscRing *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
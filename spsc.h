@@ -0,0 +1,25 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Кольцевой буфер без блокировок: ровно один писатель и один читатель.
+// Ёмкость — степень двойки, элементы фиксированного размера.
+typedef struct SpscRing {
+    _Alignas(64) atomic_uint head;  // Пишет только писатель
+    _Alignas(64) atomic_uint tail;  // Пишет только читатель
+    unsigned mask;
+    size_t elem_size;
+    uint8_t *buf;
+} SpscRing;
+
+int spsc_init(SpscRing *ring, unsigned capacity, size_t elem_size);
+void spsc_free(SpscRing *ring);
+int spsc_push(SpscRing *ring, const void *elem);
+void *spsc_peek(SpscRing *ring);
+void spsc_pop(SpscRing *ring);
+unsigned spsc_count(SpscRing *ring);
+
+#endif
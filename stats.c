@@ -0,0 +1,140 @@
+#include "stats.h"
+
+#ifdef CHIP8_STATS
+
+#include <stdio.h>
+
+Chip8Stats chip8_stats;
+
+// Названия семейств; порядок совпадает с индексами opcode_family()
+static const char *family_names[] = {
+    "00E0", "00EE", "0nnn", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk",
+    "8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7", "8xyE",
+    "9xy0", "Annn", "Bnnn", "Cxkk", "Dxyn", "Ex9E", "ExA1",
+    "Fx07", "Fx0A", "Fx15", "Fx18", "Fx1E", "Fx29", "Fx33", "Fx55", "Fx65",
+    "unknown"
+};
+#define FAMILY_COUNT (int)(sizeof(family_names) / sizeof(family_names[0]))
+#define FAMILY_UNKNOWN (FAMILY_COUNT - 1)
+
+int opcode_family(uint16_t opcode) {
+    uint8_t n = opcode & 0x0F, kk = opcode & 0xFF;
+
+    switch (opcode >> 12) {
+        case 0x0: return opcode == 0x00E0 ? 0 : opcode == 0x00EE ? 1 : 2;
+        case 0x1: case 0x2: case 0x3: case 0x4:
+            return 3 + (opcode >> 12) - 1;
+        case 0x5: return 7;
+        case 0x6: return 8;
+        case 0x7: return 9;
+        case 0x8:
+            if (n <= 0x7) return 10 + n;
+            return n == 0xE ? 18 : FAMILY_UNKNOWN;
+        case 0x9: return 19;
+        case 0xA: return 20;
+        case 0xB: return 21;
+        case 0xC: return 22;
+        case 0xD: return 23;
+        case 0xE: return kk == 0x9E ? 24 : kk == 0xA1 ? 25 : FAMILY_UNKNOWN;
+        default:
+            switch (kk) {
+                case 0x07: return 26;
+                case 0x0A: return 27;
+                case 0x15: return 28;
+                case 0x18: return 29;
+                case 0x1E: return 30;
+                case 0x29: return 31;
+                case 0x33: return 32;
+                case 0x55: return 33;
+                case 0x65: return 34;
+                default:   return FAMILY_UNKNOWN;
+            }
+    }
+}
+
+uint64_t stats_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Текстовая тепловая карта: строка — 64 байта памяти (32 инструкции),
+// яркость символа — логарифм числа выполнений относительно максимума
+static void print_heatmap(void) {
+    static const char shades[] = " .:-=+*#%@";
+    uint64_t max = 0;
+    for (int pc = 0; pc < MEMORY_SIZE; pc++) {
+        if (chip8_stats.by_pc[pc] > max) max = chip8_stats.by_pc[pc];
+    }
+    if (!max) return;
+
+    int max_bits = 64 - __builtin_clzll(max);
+    printf("Hot PCs (each char = 2 bytes, '@' = %llu executions):\n", (unsigned long long)max);
+    for (int row = 0; row < MEMORY_SIZE; row += 64) {
+        char line[33];
+        int any = 0;
+        for (int i = 0; i < 32; i++) {
+            uint64_t count = chip8_stats.by_pc[row + 2 * i] + chip8_stats.by_pc[row + 2 * i + 1];
+            int level = 0;
+            if (count) {
+                level = 1 + (64 - __builtin_clzll(count)) * 8 / max_bits;
+                if (level > 9) level = 9;
+                any = 1;
+            }
+            line[i] = shades[level];
+        }
+        line[32] = '\0';
+        if (any) printf("  %03X |%s|\n", row, line);
+    }
+}
+
+// JSON для дальнейшего анализа и краткая сводка в stdout
+void stats_dump(const CHIP8 *chip, const char *json_path) {
+    uint64_t total = 0;
+    for (int f = 0; f < FAMILY_COUNT; f++) total += chip8_stats.family[f];
+    if (!total) return;
+
+    FILE *out = fopen(json_path, "w");
+    if (!out) {
+        printf("Error: Cannot open file %s\n", json_path);
+    } else {
+        fprintf(out, "{\n  \"rom_hash\": \"%016llx\",\n  \"instructions\": %llu,\n",
+                (unsigned long long)chip->rom_hash, (unsigned long long)total);
+        fprintf(out, "  \"draw\": {\"count\": %llu, \"ns\": %llu},\n",
+                (unsigned long long)chip8_stats.draws, (unsigned long long)chip8_stats.draw_ns);
+        fprintf(out, "  \"families\": {");
+        int first = 1;
+        for (int f = 0; f < FAMILY_COUNT; f++) {
+            if (!chip8_stats.family[f]) continue;
+            fprintf(out, "%s\n    \"%s\": %llu", first ? "" : ",", family_names[f],
+                    (unsigned long long)chip8_stats.family[f]);
+            first = 0;
+        }
+        fprintf(out, "\n  },\n  \"pcs\": [");
+        first = 1;
+        for (int pc = 0; pc < MEMORY_SIZE; pc++) {
+            if (!chip8_stats.by_pc[pc]) continue;
+            uint16_t opcode = (chip->memory[pc] << 8) | chip->memory[pc + 1];
+            fprintf(out, "%s\n    {\"pc\": %d, \"opcode\": \"%04X\", \"count\": %llu}",
+                    first ? "" : ",", pc, opcode, (unsigned long long)chip8_stats.by_pc[pc]);
+            first = 0;
+        }
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+        printf("Stats written to %s\n", json_path);
+    }
+
+    printf("Opcodes (%llu executed):\n", (unsigned long long)total);
+    for (int f = 0; f < FAMILY_COUNT; f++) {
+        if (!chip8_stats.family[f]) continue;
+        printf("  %-7s %12llu  %5.1f%%\n", family_names[f],
+               (unsigned long long)chip8_stats.family[f], chip8_stats.family[f] * 100.0 / total);
+    }
+    if (chip8_stats.draws) {
+        printf("Dxyn: %llu draws, %.1f ns avg\n", (unsigned long long)chip8_stats.draws,
+               (double)chip8_stats.draw_ns / chip8_stats.draws);
+    }
+    print_heatmap();
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Счётчики ядра для профилирования ROM: сколько раз выполнялось каждое
+// семейство опкодов и каждый адрес, сколько времени ушло на Dxyn.
+// Собираются только с -DCHIP8_STATS (make STATS=1); в обычной сборке
+// макросы ниже пустые и не оставляют в ядре ни одной инструкции.
+
+#ifdef CHIP8_STATS
+
+#include <stdint.h>
+#include <time.h>
+#include "chip8.h"
+
+typedef struct Chip8Stats {
+    uint64_t family[64];            // По семействам, индекс — opcode_family()
+    uint64_t by_pc[MEMORY_SIZE];    // По адресу инструкции
+    uint64_t draw_ns;               // Время внутри Dxyn
+    uint64_t draws;
+} Chip8Stats;
+
+extern Chip8Stats chip8_stats;
+
+int opcode_family(uint16_t opcode);
+uint64_t stats_clock(void);
+void stats_dump(const CHIP8 *chip, const char *json_path);
+
+#define STATS_OPCODE(pc, opcode) \
+    (chip8_stats.family[opcode_family(opcode)]++, chip8_stats.by_pc[(pc) & ADDR_MASK]++)
+#define STATS_DRAW_BEGIN() uint64_t stats_t0 = stats_clock()
+#define STATS_DRAW_END() \
+    (chip8_stats.draw_ns += stats_clock() - stats_t0, chip8_stats.draws++)
+#define STATS_DUMP(chip) stats_dump(chip, "chip8_stats.json")
+
+#else
+
+#define STATS_OPCODE(pc, opcode) ((void)0)
+#define STATS_DRAW_BEGIN() ((void)0)
+#define STATS_DRAW_END() ((void)0)
+#define STATS_DUMP(chip) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+#include "trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_EVENTS 65536          // Событий на поток (~4,5 минуты при 60 кадрах и 4 событиях на кадр)
+#define TRACE_MAX_THREADS 16
+
+typedef struct TraceEvent {
+    const char *name;               // Строковый литерал, не копируется
+    uint64_t start, end;            // Наносекунды CLOCK_MONOTONIC
+} TraceEvent;
+
+typedef struct TraceBuffer {
+    char name[32];
+    uint64_t head;                  // Всего записано; пишет только свой поток
+    TraceEvent events[TRACE_EVENTS];
+} TraceBuffer;
+
+int trace_enabled = 0;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *buffers[TRACE_MAX_THREADS];
+static int buffer_count = 0;
+static uint64_t trace_origin;
+static _Thread_local TraceBuffer *local;
+
+void trace_start(void) {
+    trace_origin = trace_now();
+    trace_enabled = 1;
+}
+
+uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Буфер потока создаётся при первом событии; блокировка берётся только тут
+static TraceBuffer *thread_buffer(void) {
+    if (local) return local;
+    pthread_mutex_lock(&trace_lock);
+    if (buffer_count < TRACE_MAX_THREADS) {
+        local = calloc(1, sizeof(TraceBuffer));
+        if (local) {
+            snprintf(local->name, sizeof(local->name), "thread %d", buffer_count);
+            buffers[buffer_count++] = local;
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    return local;
+}
+
+void trace_thread_name(const char *name) {
+    if (!trace_enabled) return;
+    TraceBuffer *buf = thread_buffer();
+    if (buf) snprintf(buf->name, sizeof(buf->name), "%s", name);
+}
+
+// Завершённое событие [start, end) — для отрезков, которые решено
+// записать уже после их окончания
+void trace_span(const char *name, uint64_t start, uint64_t end) {
+    TraceBuffer *buf = thread_buffer();
+    if (!buf) return;
+    TraceEvent *ev = &buf->events[buf->head % TRACE_EVENTS];
+    ev->name = name;
+    ev->start = start;
+    ev->end = end;
+    buf->head++;
+}
+
+// Завершённое событие [start, сейчас)
+void trace_event(const char *name, uint64_t start) {
+    trace_span(name, start, trace_now());
+}
+
+// Вызывать, когда все трассируемые потоки остановлены
+int trace_dump(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        printf("Error: Cannot open file %s\n", path);
+        return 0;
+    }
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(out, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, "
+                 "\"args\": {\"name\": \"chip8\"}}");
+    long total = 0;
+    for (int t = 0; t < buffer_count; t++) {
+        TraceBuffer *buf = buffers[t];
+        fprintf(out, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                     "\"args\": {\"name\": \"%s\"}}", t + 1, buf->name);
+        uint64_t first = buf->head > TRACE_EVENTS ? buf->head - TRACE_EVENTS : 0;
+        for (uint64_t i = first; i < buf->head; i++) {
+            const TraceEvent *ev = &buf->events[i % TRACE_EVENTS];
+            if (ev->start < trace_origin) continue;
+            fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                         "\"ts\": %.3f, \"dur\": %.3f}",
+                    ev->name, t + 1, (ev->start - trace_origin) / 1000.0,
+                    (ev->end - ev->start) / 1000.0);
+            total++;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    printf("Trace: %ld events from %d threads written to %s\n", total, buffer_count, path);
+    return 1;
+}
@@ -0,0 +1,24 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Трассировка фаз кадра в формате Chrome trace-event (открывается в
+// Perfetto и chrome://tracing). Каждый поток пишет в собственный
+// кольцевой буфер без блокировок; при переполнении теряются старые
+// события. Пока трассировка не включена, TRACE_BEGIN — одна проверка.
+
+extern int trace_enabled;
+
+void trace_start(void);
+void trace_thread_name(const char *name);
+uint64_t trace_now(void);
+void trace_event(const char *name, uint64_t start);
+void trace_span(const char *name, uint64_t start, uint64_t end);
+int trace_dump(const char *path);
+
+// uint64_t t = TRACE_BEGIN(); ... TRACE_END("фаза", t);
+#define TRACE_BEGIN() (trace_enabled ? trace_now() : 0)
+#define TRACE_END(name, start) do { if (start) trace_event(name, start); } while (0)
+
+#endif
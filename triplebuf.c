@@ -0,0 +1,38 @@
+#include "triplebuf.h"
+#include <string.h>
+
+#define TB_FRESH 0x4u   // Средний слот содержит ещё не прочитанный кадр
+#define TB_INDEX 0x3u
+
+void tb_init(TripleBuffer *tb) {
+    memset(tb->slots, 0, sizeof(tb->slots));
+    tb->back = 0;
+    atomic_init(&tb->middle, 1);
+    tb->front = 2;
+}
+
+FrameSnapshot *tb_back(TripleBuffer *tb) {
+    return &tb->slots[tb->back];
+}
+
+// Публикация готового кадра: back становится middle, старый middle — новым back.
+// Непрочитанный кадр просто перезаписывается, писатель никогда не ждёт.
+void tb_publish(TripleBuffer *tb) {
+    unsigned old = atomic_exchange_explicit(&tb->middle, tb->back | TB_FRESH,
+                                            memory_order_acq_rel);
+    tb->back = old & TB_INDEX;
+}
+
+// Забирает последний опубликованный кадр. Если нового кадра нет,
+// возвращает прежний front и *fresh = 0. Читатель тоже никогда не ждёт.
+const FrameSnapshot *tb_acquire(TripleBuffer *tb, int *fresh) {
+    if (!(atomic_load_explicit(&tb->middle, memory_order_relaxed) & TB_FRESH)) {
+        if (fresh) *fresh = 0;
+        return &tb->slots[tb->front];
+    }
+    unsigned old = atomic_exchange_explicit(&tb->middle, tb->front,
+                                            memory_order_acq_rel);
+    tb->front = old & TB_INDEX;
+    if (fresh) *fresh = 1;
+    return &tb->slots[tb->front];
+}
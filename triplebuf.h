@@ -0,0 +1,30 @@
+#ifndef TRIPLEBUF_H
+#define TRIPLEBUF_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "chip8.h"
+
+// Снимок экрана, который поток эмуляции передаёт потоку отрисовки
+typedef struct FrameSnapshot {
+    uint64_t display[SCREEN_WORDS]; // Копия chip->display (256 байт)
+    uint32_t dirty_rows;            // Строки, изменённые с предыдущего снимка
+    uint32_t seq;                   // Порядковый номер снимка
+} FrameSnapshot;
+
+// Тройной буфер без блокировок: один писатель, один читатель.
+// Писатель всегда пишет в back, читатель всегда читает front,
+// а middle — последний опубликованный кадр. Обмен — одна атомарная операция.
+typedef struct TripleBuffer {
+    FrameSnapshot slots[3];
+    atomic_uint middle;   // Индекс среднего слота | TB_FRESH
+    unsigned back;        // Слот писателя
+    unsigned front;       // Слот читателя
+} TripleBuffer;
+
+void tb_init(TripleBuffer *tb);
+FrameSnapshot *tb_back(TripleBuffer *tb);
+void tb_publish(TripleBuffer *tb);
+const FrameSnapshot *tb_acquire(TripleBuffer *tb, int *fresh);
+
+#endif
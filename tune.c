@@ -0,0 +1,107 @@
+#include "tune.h"
+#include "headless.h"
+#include "db.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TUNE_FRAMES 1800            // 30 секунд эмуляции на каждую скорость
+#define TUNE_IDLE 0.20              // Доля инструкций в ожидании DT, с которой игра «успевает»
+
+// Перебираемые скорости, инструкций в секунду
+static const int sweep[] = { 300, 420, 540, 660, 780, 900, 1200, 1500, 1800, 2400, 3000 };
+#define SWEEP_COUNT (int)(sizeof(sweep) / sizeof(sweep[0]))
+
+// Подбор скорости: ROM прогоняется без окна на каждой скорости, и считается,
+// какая доля времени уходит на циклы ожидания DT (повторные Fx07 с одного
+// адреса, пока DT > 0). Пока игре не хватает скорости, кадр занят работой и циклы
+// ожидания не крутятся; скорость, на которой доля опросов впервые
+// переходит через TUNE_IDLE (на предыдущей скорости она была ниже), —
+// та, на которую рассчитаны задержки игры.
+// Возвращает IPS, 0 если такого перехода нет (игра не ждёт по DT или ждёт
+// уже на самой низкой скорости, то есть доля ожидания от скорости не
+// зависит), или -1 при ошибке.
+int tune_ips(const CHIP8 *rom, long frames, int verbose) {
+    int best = 0;
+    int below = 0;  // На предыдущей скорости доля ожидания была ниже TUNE_IDLE
+
+    for (int s = 0; s < SWEEP_COUNT && !best; s++) {
+        int ipf = sweep[s] / FRAME_RATE;
+        HeadlessRun run;
+        if (!run_init(&run, ipf, 0)) return -1;
+        // Память, хэш и особенности берём из загруженного ROM, время — с нуля
+        memcpy(run.chip.memory, rom->memory, sizeof(run.chip.memory));
+        run.chip.quirks = rom->quirks;
+        run.chip.rom_hash = rom->rom_hash;
+
+        for (long f = 0; f < frames; f++) run_frame(&run, NULL);
+
+        double idle = run.instructions ? (double)run.chip.dt_wait / run.instructions : 0;
+        if (verbose) printf("%5d IPS: %5.1f%% waiting on DT\n", sweep[s], idle * 100);
+        if (idle >= TUNE_IDLE && below) best = sweep[s];
+        below = idle < TUNE_IDLE;
+        run_free(&run);
+    }
+    return best;
+}
+
+// tune <rom_file|game_id> [--frames N] [--dry-run]
+int tune_main(int argc, char *argv[]) {
+    const char *rom_arg = NULL;
+    long frames = TUNE_FRAMES;
+    int dry_run = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dry-run") == 0) {
+            dry_run = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        } else if (!rom_arg) {
+            rom_arg = argv[i];
+        }
+    }
+    if (!rom_arg || frames <= 0) {
+        fprintf(stderr, "Usage: tune <rom_file|game_id> [--frames N] [--dry-run]\n");
+        return 1;
+    }
+
+    GameDB *db = init_db("chip8_games.db");
+    if (!db) return 1;
+    populate_default_games(db);  // Хэши ROM нужны, чтобы сохранить результат
+
+    CHIP8 chip;
+    initialize(&chip);
+    int loaded = 0;
+    char *endptr;
+    long id = strtol(rom_arg, &endptr, 10);
+    if (*endptr == '\0') loaded = load_game(db, (int)id, &chip);
+    else loaded = load_rom(&chip, rom_arg);
+    if (!loaded) {
+        printf("Failed to load ROM.\n");
+        close_db(db);
+        return 1;
+    }
+    RomConfig cfg;
+    if (db_find_config(db, chip.rom_hash, &cfg)) chip.quirks = (uint8_t)cfg.quirks;
+
+    int ips = tune_ips(&chip, frames, 1);
+    int rc = 0;
+    if (ips < 0) {
+        printf("Error: cannot allocate emulator state\n");
+        rc = 1;
+    } else if (ips == 0) {
+        printf("No speed where waiting on the delay timer sets in; keeping the default.\n");
+    } else {
+        printf("Chosen speed: %d IPS\n", ips);
+        if (!dry_run) {
+            int updated = db_store_ips(db, chip.rom_hash, ips);
+            if (updated > 0) printf("Stored for ROM %016llx.\n", (unsigned long long)chip.rom_hash);
+            else if (updated == 0) printf("ROM is not in the library (see import); not stored.\n");
+            else rc = 1;
+        }
+    }
+    close_db(db);
+    return rc;
+}
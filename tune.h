@@ -0,0 +1,9 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include "chip8.h"
+
+int tune_ips(const CHIP8 *rom, long frames, int verbose);
+int tune_main(int argc, char *argv[]);
+
+#endif
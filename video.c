@@ -0,0 +1,268 @@
+#include "video.h"
+#include "chip8.h"
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Разворачивает строку экрана (1 бит на пиксель, бит x = столбец x)
+// в 64 пикселя по 32 бита
+void expand_row(uint64_t bits, uint32_t *out, uint32_t on, uint32_t off) {
+#if defined(__AVX2__)
+    const __m256i m = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i von = _mm256_set1_epi32((int)on);
+    const __m256i voff = _mm256_set1_epi32((int)off);
+    for (int i = 0; i < 8; i++) {
+        __m256i v = _mm256_set1_epi32((int)((bits >> (i * 8)) & 0xFF));
+        __m256i sel = _mm256_cmpeq_epi32(_mm256_and_si256(v, m), m);
+        _mm256_storeu_si256((__m256i*)(out + i * 8), _mm256_blendv_epi8(voff, von, sel));
+    }
+#elif defined(__SSE2__)
+    const __m128i m = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i von = _mm_set1_epi32((int)on);
+    const __m128i voff = _mm_set1_epi32((int)off);
+    for (int i = 0; i < 16; i++) {
+        __m128i v = _mm_set1_epi32((int)((bits >> (i * 4)) & 0xF));
+        __m128i sel = _mm_cmpeq_epi32(_mm_and_si128(v, m), m);
+        __m128i px = _mm_or_si128(_mm_and_si128(sel, von), _mm_andnot_si128(sel, voff));
+        _mm_storeu_si128((__m128i*)(out + i * 4), px);
+    }
+#else
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        out[x] = ((bits >> x) & 1) ? on : off;
+    }
+#endif
+}
+
+// Разворачивает весь экран; pitch — длина строки назначения в байтах
+void expand_display(const uint64_t *display, int rows, uint32_t *pixels, int pitch,
+                    uint32_t on, uint32_t off) {
+    for (int y = 0; y < rows; y++) {
+        expand_row(display[y], (uint32_t*)((uint8_t*)pixels + (long)y * pitch), on, off);
+    }
+}
+
+// ---- Программное увеличение ----
+//
+// Фильтры работают прямо над 64-битными словами строк: каждая побитовая
+// операция обрабатывает сразу 64 пикселя. Результат — f подстрок по 64*f бит,
+// которые затем разворачиваются в пиксели и размножаются в k раз.
+
+static uint16_t spread2[256];   // Бит i -> бит 2i
+static uint32_t spread3[256];   // Бит i -> бит 3i
+static int spread_ready = 0;
+
+static void init_spread(void) {
+    for (int b = 0; b < 256; b++) {
+        uint16_t s2 = 0;
+        uint32_t s3 = 0;
+        for (int i = 0; i < 8; i++) {
+            if (b & (1 << i)) {
+                s2 |= (uint16_t)(1u << (2 * i));
+                s3 |= 1u << (3 * i);
+            }
+        }
+        spread2[b] = s2;
+        spread3[b] = s3;
+    }
+    spread_ready = 1;
+}
+
+// Чередует биты: результат[2i] = a[i], результат[2i+1] = b[i]
+static void interleave2(uint64_t a, uint64_t b, uint64_t out[2]) {
+    uint8_t *o = (uint8_t*)out;   // x86: порядок байт little-endian
+    for (int i = 0; i < 8; i++) {
+        uint16_t v = spread2[(a >> (8 * i)) & 0xFF] |
+                     (uint16_t)(spread2[(b >> (8 * i)) & 0xFF] << 1);
+        o[2 * i] = (uint8_t)v;
+        o[2 * i + 1] = (uint8_t)(v >> 8);
+    }
+}
+
+// Результат[3i] = a[i], [3i+1] = b[i], [3i+2] = c[i]
+static void interleave3(uint64_t a, uint64_t b, uint64_t c, uint64_t out[3]) {
+    uint8_t *o = (uint8_t*)out;
+    for (int i = 0; i < 8; i++) {
+        uint32_t v = spread3[(a >> (8 * i)) & 0xFF] |
+                     (spread3[(b >> (8 * i)) & 0xFF] << 1) |
+                     (spread3[(c >> (8 * i)) & 0xFF] << 2);
+        o[3 * i] = (uint8_t)v;
+        o[3 * i + 1] = (uint8_t)(v >> 8);
+        o[3 * i + 2] = (uint8_t)(v >> 16);
+    }
+}
+
+// Соседи по горизонтали с повтором крайнего пикселя
+static inline uint64_t left_of(uint64_t r)  { return (r << 1) | (r & 1); }
+static inline uint64_t right_of(uint64_t r) { return (r >> 1) | (r & (1ULL << 63)); }
+// Побитовое «если m, то a, иначе b»
+static inline uint64_t sel(uint64_t m, uint64_t a, uint64_t b) { return (m & a) | (~m & b); }
+
+// Разворачивает nwords слов в пиксели, каждый пиксель повторяется k раз
+static void expand_scaled(const uint64_t *words, int nwords, int k, uint32_t *out,
+                          uint32_t on, uint32_t off) {
+    uint32_t px[SCREEN_WIDTH * 3];
+    for (int w = 0; w < nwords; w++) {
+        expand_row(words[w], px + w * SCREEN_WIDTH, on, off);
+    }
+    int n = nwords * SCREEN_WIDTH;
+    if (k == 1) {
+        memcpy(out, px, n * sizeof(uint32_t));
+        return;
+    }
+    for (int x = 0; x < n; x++) {
+        uint32_t *dst = out + x * k;
+        int j = 0;
+#if defined(__AVX2__)
+        __m256i v8 = _mm256_set1_epi32((int)px[x]);
+        for (; j + 8 <= k; j += 8) _mm256_storeu_si256((__m256i*)(dst + j), v8);
+#endif
+#if defined(__SSE2__)
+        __m128i v4 = _mm_set1_epi32((int)px[x]);
+        for (; j + 4 <= k; j += 4) _mm_storeu_si128((__m128i*)(dst + j), v4);
+#endif
+        for (; j < k; j++) dst[j] = px[x];
+    }
+}
+
+// Размер результата: 64*f*k x 32*f*k, где k = scale / f (не меньше 1)
+void upscale_size(ScaleFilter filter, int scale, int *width, int *height) {
+    int f = (int)filter;
+    int k = scale / f;
+    if (k < 1) k = 1;
+    *width = SCREEN_WIDTH * f * k;
+    *height = SCREEN_HEIGHT * f * k;
+}
+
+// Строит f*k строк результата для строки экрана y.
+// pixels указывает на первую из них, pitch — длина строки в байтах.
+void upscale_row(const uint64_t *display, int y, ScaleFilter filter, int scale,
+                 uint32_t *pixels, int pitch, uint32_t on, uint32_t off) {
+    if (!spread_ready) init_spread();
+
+    int f = (int)filter;
+    int k = scale / f;
+    if (k < 1) k = 1;
+
+    uint64_t E = display[y];
+    uint64_t B = display[y > 0 ? y - 1 : y];
+    uint64_t H = display[y < SCREEN_HEIGHT - 1 ? y + 1 : y];
+    uint64_t D = left_of(E), F = right_of(E);
+    uint64_t sub[3][3];   // f подстрок по f слов
+
+    if (filter == FILTER_NEAREST) {
+        sub[0][0] = E;
+    } else {
+        // Условия EPX: X == Y соответствует ~(X ^ Y), X != Y — (X ^ Y)
+        uint64_t cDB = ~(D ^ B) & (B ^ F) & (D ^ H);
+        uint64_t cBF = ~(B ^ F) & (B ^ D) & (F ^ H);
+        uint64_t cDH = ~(D ^ H) & (D ^ B) & (H ^ F);
+        uint64_t cHF = ~(H ^ F) & (D ^ H) & (B ^ F);
+
+        if (filter == FILTER_SCALE2X) {
+            interleave2(sel(cDB, D, E), sel(cBF, F, E), sub[0]);
+            interleave2(sel(cDH, D, E), sel(cHF, F, E), sub[1]);
+        } else {
+            uint64_t A = left_of(B), C = right_of(B);
+            uint64_t G = left_of(H), I = right_of(H);
+            uint64_t e1 = sel((cDB & (E ^ C)) | (cBF & (E ^ A)), B, E);
+            uint64_t e3 = sel((cDB & (E ^ G)) | (cDH & (E ^ A)), D, E);
+            uint64_t e5 = sel((cBF & (E ^ I)) | (cHF & (E ^ C)), F, E);
+            uint64_t e7 = sel((cDH & (E ^ I)) | (cHF & (E ^ G)), H, E);
+            interleave3(sel(cDB, D, E), e1, sel(cBF, F, E), sub[0]);
+            interleave3(e3, E, e5, sub[1]);
+            interleave3(sel(cDH, D, E), e7, sel(cHF, F, E), sub[2]);
+        }
+    }
+
+    int width = SCREEN_WIDTH * f * k;
+    for (int s = 0; s < f; s++) {
+        uint32_t *first = (uint32_t*)((uint8_t*)pixels + (long)(s * k) * pitch);
+        expand_scaled(sub[s], f, k, first, on, off);
+        for (int r = 1; r < k; r++) {
+            memcpy((uint8_t*)first + (long)r * pitch, first, width * sizeof(uint32_t));
+        }
+    }
+}
+
+// ---- Послесвечение ----
+
+// Палитра игры сохраняется: яркость смешивает цвета off и on по каналам
+void phosphor_init(Phosphor *ph, uint32_t on, uint32_t off) {
+    memset(ph, 0, sizeof(*ph));
+    for (int lv = 0; lv < 256; lv++) {
+        uint32_t c = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int a = (off >> shift) & 0xFF, b = (on >> shift) & 0xFF;
+            c |= (uint32_t)(a + ((b - a) * lv + (b >= a ? 127 : -127)) / 255) << shift;
+        }
+        ph->palette[lv] = c;
+    }
+}
+
+// Один шаг затухания: горящие пиксели получают полную яркость, погасшие
+// теряют (level >> PHOSPHOR_DECAY_SHIFT) + 1. Возвращает маску строк,
+// где яркость изменилась; ровно горящие и тёмные строки в неё не входят.
+// Стоимость фиксирована: 2048 байт за кадр.
+uint32_t phosphor_update(Phosphor *ph, const uint64_t *display) {
+    uint32_t changed = 0, lit = 0, active = 0;
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        uint64_t bits = display[y];
+        uint8_t *row = ph->level[y];
+        // Строка тёмная и ничего не горит — пропускаем
+        if (!bits && !(ph->lit_rows & (1u << y))) continue;
+#if defined(__SSE2__)
+        const __m128i bitsel = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128,
+                                             1, 2, 4, 8, 16, 32, 64, (char)128);
+        const __m128i low = _mm_set1_epi8((char)(0xFF >> PHOSPHOR_DECAY_SHIFT));
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i full = _mm_set1_epi8((char)0xFF);
+        __m128i diff = zero, after = zero, mid = zero;
+        for (int i = 0; i < 4; i++) {
+            // 16 бит строки -> 16 байт-масок горящих пикселей
+            uint8_t b0 = (uint8_t)(bits >> (i * 16));
+            uint8_t b1 = (uint8_t)(bits >> (i * 16 + 8));
+            __m128i v = _mm_unpacklo_epi64(_mm_set1_epi8((char)b0), _mm_set1_epi8((char)b1));
+            __m128i lit_px = _mm_cmpeq_epi8(_mm_and_si128(v, bitsel), bitsel);
+
+            __m128i lv = _mm_loadu_si128((const __m128i*)(row + i * 16));
+            __m128i step = _mm_adds_epu8(_mm_and_si128(_mm_srli_epi16(lv, PHOSPHOR_DECAY_SHIFT), low), one);
+            __m128i nv = _mm_max_epu8(_mm_subs_epu8(lv, step), lit_px);
+            _mm_storeu_si128((__m128i*)(row + i * 16), nv);
+            diff = _mm_or_si128(diff, _mm_xor_si128(lv, nv));
+            after = _mm_or_si128(after, nv);
+            // Промежуточная яркость: не 0 и не 255
+            __m128i edge = _mm_or_si128(_mm_cmpeq_epi8(nv, zero), _mm_cmpeq_epi8(nv, full));
+            mid = _mm_or_si128(mid, _mm_andnot_si128(edge, full));
+        }
+        int moved = _mm_movemask_epi8(_mm_cmpeq_epi8(diff, zero)) != 0xFFFF;
+        int nonzero = _mm_movemask_epi8(_mm_cmpeq_epi8(after, zero)) != 0xFFFF;
+        int fading = _mm_movemask_epi8(mid) != 0;
+#else
+        int moved = 0, nonzero = 0, fading = 0;
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            uint8_t lv = row[x];
+            int step = (lv >> PHOSPHOR_DECAY_SHIFT) + 1;
+            uint8_t nv = ((bits >> x) & 1) ? 255 : (lv > step ? lv - step : 0);
+            row[x] = nv;
+            moved |= nv != lv;
+            nonzero |= nv;
+            fading |= nv != 0 && nv != 255;
+        }
+#endif
+        if (moved) changed |= 1u << y;
+        if (nonzero) lit |= 1u << y;
+        if (fading) active |= 1u << y;
+    }
+    ph->lit_rows = lit;
+    ph->active_rows = active;
+    return changed;
+}
+
+// Яркость -> цвет по палитре игры (phosphor_init), ARGB8888
+void phosphor_expand_row(const Phosphor *ph, int y, uint32_t *out) {
+    const uint8_t *level = ph->level[y];
+    for (int x = 0; x < SCREEN_WIDTH; x++) out[x] = ph->palette[level[x]];
+}
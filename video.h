@@ -0,0 +1,41 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+// Цвета пикселей в формате ARGB8888
+#define COLOR_ON  0xFFFFFFFFu
+#define COLOR_OFF 0xFF000000u
+
+// Программные фильтры увеличения (для хостов без GPU)
+typedef enum ScaleFilter {
+    FILTER_NEAREST = 1,   // Целочисленное увеличение без сглаживания
+    FILTER_SCALE2X = 2,   // Scale2x/EPX, затем целочисленное увеличение
+    FILTER_SCALE3X = 3    // Scale3x, затем целочисленное увеличение
+} ScaleFilter;
+
+void expand_row(uint64_t bits, uint32_t *out, uint32_t on, uint32_t off);
+void expand_display(const uint64_t *display, int rows, uint32_t *pixels, int pitch,
+                    uint32_t on, uint32_t off);
+// Послесвечение люминофора: яркость каждого пикселя плавно гаснет после
+// выключения, поэтому спрайты, перерисовываемые через XOR, не мерцают
+typedef struct Phosphor {
+    uint8_t level[SCREEN_HEIGHT][SCREEN_WIDTH]; // Яркость 0..255
+    uint32_t lit_rows;                          // Строки, где есть ненулевая яркость
+    uint32_t active_rows;                       // Строки, где что-то ещё гаснет (0 < яркость < 255)
+    uint32_t palette[256];                      // Яркость -> цвет между off и on
+} Phosphor;
+
+#define PHOSPHOR_DECAY_SHIFT 2   // За кадр гаснет ~1/4 яркости
+#define PHOSPHOR_MAX_STEPS 16    // Шагов, за которые гаснет полная яркость
+
+void phosphor_init(Phosphor *ph, uint32_t on, uint32_t off);
+uint32_t phosphor_update(Phosphor *ph, const uint64_t *display);
+void phosphor_expand_row(const Phosphor *ph, int y, uint32_t *out);
+
+void upscale_size(ScaleFilter filter, int scale, int *width, int *height);
+void upscale_row(const uint64_t *display, int y, ScaleFilter filter, int scale,
+                 uint32_t *pixels, int pitch, uint32_t on, uint32_t off);
+
+#endif